@@ -0,0 +1,161 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// command line of the benchmark mode:
+//     project_base --bench [--frames N] [--warmup N] [--camera-path file] [--output file] [--render-scale S] [--gpu-budget ms] [--deferred] [--depth-prepass]
+//                  [--shadow-cascades N] [--shadow-resolution R] [--no-shadow-cache] [--point-shadow-budget N] [--no-occlusion] [--lod-error px]
+struct BenchOptions {
+    bool enabled = false;
+    unsigned int frames = 1000;     // measured frames
+    unsigned int warmup = 60;       // frames rendered before measuring starts
+    float timestep = 1.0f / 60.0f;  // scene time advanced per frame, independent of how fast frames render
+    std::string cameraPath = "resources/bench_camera.txt";
+    std::string output = "bench.json";
+    float renderScale = 1.0f;       // of the scene's render targets relative to the window, see RenderTargetPool
+    float gpuBudgetMs = 0.0f;       // if set, DynamicResolution adjusts the render scale to stay under it
+    bool deferred = false;          // shade with DeferredRenderer instead of the forward shaders
+    bool depthPrepass = false;      // lay down depth first, then shade only the visible fragments
+    int shadowCascades = 4;         // of the directional light's CascadedShadowMaps, 0 turns shadows off
+    int shadowResolution = 2048;    // of every cascade
+    bool shadowCache = true;        // static casters rendered once instead of every frame
+    int pointShadowBudget = 4;      // point light shadows re-rendered per frame, 0 turns them off
+    bool occlusionCulling = true;   // meshes hidden behind the previous frames' depth are not drawn
+    float lodPixelError = 1.0f;     // screen space error allowed when picking mesh LODs, 0 draws full detail
+};
+
+// returns false (after printing why) if the arguments can't be parsed
+inline bool ParseBenchOptions(int argc, char **argv, BenchOptions &options)
+{
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--bench") == 0)
+            options.enabled = true;
+        else if (std::strcmp(argv[i], "--frames") == 0 && hasValue)
+            options.frames = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--warmup") == 0 && hasValue)
+            options.warmup = std::max(0, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--camera-path") == 0 && hasValue)
+            options.cameraPath = argv[++i];
+        else if (std::strcmp(argv[i], "--output") == 0 && hasValue)
+            options.output = argv[++i];
+        else if (std::strcmp(argv[i], "--render-scale") == 0 && hasValue)
+            options.renderScale = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--deferred") == 0)
+            options.deferred = true;
+        else if (std::strcmp(argv[i], "--depth-prepass") == 0)
+            options.depthPrepass = true;
+        else if (std::strcmp(argv[i], "--shadow-cascades") == 0 && hasValue)
+            options.shadowCascades = std::min(std::max(std::atoi(argv[++i]), 0), 4);
+        else if (std::strcmp(argv[i], "--shadow-resolution") == 0 && hasValue)
+            options.shadowResolution = std::min(std::max(std::atoi(argv[++i]), 256), 8192);
+        else if (std::strcmp(argv[i], "--no-shadow-cache") == 0)
+            options.shadowCache = false;
+        else if (std::strcmp(argv[i], "--point-shadow-budget") == 0 && hasValue)
+            options.pointShadowBudget = std::max(0, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--no-occlusion") == 0)
+            options.occlusionCulling = false;
+        else if (std::strcmp(argv[i], "--lod-error") == 0 && hasValue)
+            options.lodPixelError = std::max(0.0, std::atof(argv[++i]));
+        else if (std::strcmp(argv[i], "--gpu-budget") == 0 && hasValue)
+            options.gpuBudgetMs = std::max(0.0, std::atof(argv[++i]));
+        else {
+            std::cout << "ERROR::BENCH:: unknown argument " << argv[i] << std::endl;
+            std::cout << "usage: " << argv[0] << " [--bench [--frames N] [--warmup N] [--camera-path file] [--output file] [--render-scale S] [--gpu-budget ms] [--deferred] [--depth-prepass] [--shadow-cascades N] [--shadow-resolution R] [--no-shadow-cache] [--point-shadow-budget N] [--no-occlusion] [--lod-error px]]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// collects frame times in milliseconds and summarizes them as percentiles
+class BenchRecorder
+{
+public:
+    std::vector<float> cpuMs;   // CPU time spent recording the frame's GL commands
+    std::vector<float> gpuMs;   // GPU time of all profiled passes
+    std::vector<float> frameMs; // wall clock time from one frame to the next
+    std::vector<float> renderScale; // of every measured frame
+
+    // writes the summary as JSON to path and to stdout
+    bool WriteJson(const std::string &path, const BenchOptions &options, const std::string &renderer) const
+    {
+        std::ostringstream json;
+        json << "{\n"
+             << "  \"renderer\": \"" << escape(renderer) << "\",\n"
+             << "  \"frames\": " << options.frames << ",\n"
+             << "  \"warmup\": " << options.warmup << ",\n"
+             << "  \"camera_path\": \"" << escape(options.cameraPath) << "\",\n"
+             << "  \"shading\": \"" << (options.deferred ? "deferred" : "forward") << "\",\n"
+             << "  \"shadow_cascades\": " << options.shadowCascades << ",\n"
+             << "  \"shadow_resolution\": " << options.shadowResolution << ",\n"
+             << "  \"shadow_cache\": " << (options.shadowCache ? "true" : "false") << ",\n"
+             << "  \"point_shadow_budget\": " << options.pointShadowBudget << ",\n"
+             << "  \"occlusion_culling\": " << (options.occlusionCulling ? "true" : "false") << ",\n"
+             << "  \"lod_pixel_error\": " << options.lodPixelError << ",\n"
+             << "  \"depth_prepass\": " << (options.depthPrepass ? "true" : "false") << ",\n"
+             << "  \"gpu_budget_ms\": " << options.gpuBudgetMs << ",\n"
+             << "  \"render_scale\": " << summary(renderScale) << ",\n"
+             << "  \"cpu_ms\": " << summary(cpuMs) << ",\n"
+             << "  \"gpu_ms\": " << summary(gpuMs) << ",\n"
+             << "  \"frame_ms\": " << summary(frameMs) << "\n"
+             << "}\n";
+        std::cout << json.str();
+        std::ofstream out(path);
+        if (!out) {
+            std::cout << "ERROR::BENCH:: can't write " << path << std::endl;
+            return false;
+        }
+        out << json.str();
+        return true;
+    }
+
+    // nearest-rank percentile of samples, p in [0, 100]
+    static float Percentile(std::vector<float> samples, float p)
+    {
+        if (samples.empty())
+            return 0.0f;
+        std::sort(samples.begin(), samples.end());
+        size_t rank = (size_t)std::ceil(p / 100.0f * samples.size());
+        return samples[std::min(std::max<size_t>(rank, 1), samples.size()) - 1];
+    }
+
+private:
+    static std::string summary(const std::vector<float> &samples)
+    {
+        float sum = 0.0f, max = 0.0f;
+        for (float sample : samples) {
+            sum += sample;
+            max = std::max(max, sample);
+        }
+        std::ostringstream out;
+        out << "{\"samples\": " << samples.size()
+            << ", \"mean\": " << (samples.empty() ? 0.0f : sum / samples.size())
+            << ", \"p50\": " << Percentile(samples, 50.0f)
+            << ", \"p95\": " << Percentile(samples, 95.0f)
+            << ", \"p99\": " << Percentile(samples, 99.0f)
+            << ", \"max\": " << max << "}";
+        return out.str();
+    }
+
+    static std::string escape(const std::string &s)
+    {
+        std::string result;
+        for (char c : s) {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result;
+    }
+};
+#endif
@@ -0,0 +1,147 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/fullscreen_quad.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// Bloom as a chain of progressively smaller images (mips), each half the size of the one before.
+// The bright parts of the frame are filtered down the chain with a 13-tap filter, then added back up it
+// with a 3x3 tent filter, so every level contributes a wider blur than the last. The widest blur costs
+// about as much as a single full resolution pass, because the levels together hold a third of the pixels
+// of the first one.
+class BloomMipChain
+{
+public:
+    struct Mip {
+        unsigned int texture;
+        unsigned int framebuffer;
+        int width, height;
+    };
+
+    std::vector<Mip> mips;
+    int width = 0, height = 0;     // of the frame the chain was built for
+    float filterRadius = 0.005f;   // upsample tent radius in texture coordinates
+
+    BloomMipChain(unsigned int width, unsigned int height, unsigned int levels = 6)
+        : downsampleShader("resources/shaders/blur.vs", "resources/shaders/bloom_downsample.fs"),
+          upsampleShader("resources/shaders/blur.vs", "resources/shaders/bloom_upsample.fs")
+    {
+        downsampleShader.use();
+        downsampleShader.setInt("srcTexture", 0);
+        uKaris = downsampleShader.uniform("karisAverage");
+        upsampleShader.use();
+        upsampleShader.setInt("srcTexture", 0);
+        uFilterRadius = upsampleShader.uniform("filterRadius");
+        Resize(width, height, levels);
+    }
+
+    BloomMipChain(const BloomMipChain &) = delete;
+    BloomMipChain &operator=(const BloomMipChain &) = delete;
+
+    // (re)creates the chain for a frame of width x height; the first mip is half that size
+    void Resize(unsigned int width, unsigned int height, unsigned int levels = 6)
+    {
+        Clear();
+        this->width = width;
+        this->height = height;
+        int w = width, h = height;
+        for (unsigned int i = 0; i < levels && w > 1 && h > 1; i++) {
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+            Mip mip;
+            mip.width = w;
+            mip.height = h;
+            glGenTextures(1, &mip.texture);
+            glBindTexture(GL_TEXTURE_2D, mip.texture);
+            // no alpha needed; R11F_G11F_B10F halves the bandwidth of RGBA16F
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, w, h, 0, GL_RGB, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+            glGenFramebuffers(1, &mip.framebuffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, mip.framebuffer);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mip.texture, 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::BLOOM:: mip framebuffer not complete" << std::endl;
+            mips.push_back(mip);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // blurs brightTexture (the frame's bright pass) and returns the texture holding the result.
+    // Leaves the default framebuffer bound and restores the viewport
+    unsigned int Render(unsigned int brightTexture)
+    {
+        if (mips.empty())
+            return brightTexture;
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        glActiveTexture(GL_TEXTURE0);
+
+        // downsample: frame -> mip 0 -> mip 1 -> ...
+        downsampleShader.use();
+        unsigned int source = brightTexture;
+        for (unsigned int i = 0; i < mips.size(); i++) {
+            // averaging by luminance on the first step keeps single very bright pixels from flickering
+            downsampleShader.setBool(uKaris, i == 0);
+            glBindFramebuffer(GL_FRAMEBUFFER, mips[i].framebuffer);
+            glViewport(0, 0, mips[i].width, mips[i].height);
+            glBindTexture(GL_TEXTURE_2D, source);
+            renderQuad();
+            source = mips[i].texture;
+        }
+
+        // upsample: ... -> mip 1 -> mip 0, adding each blurred level onto the larger one
+        upsampleShader.use();
+        upsampleShader.setFloat(uFilterRadius, filterRadius);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        for (unsigned int i = mips.size() - 1; i > 0; i--) {
+            glBindFramebuffer(GL_FRAMEBUFFER, mips[i - 1].framebuffer);
+            glViewport(0, 0, mips[i - 1].width, mips[i - 1].height);
+            glBindTexture(GL_TEXTURE_2D, mips[i].texture);
+            renderQuad();
+        }
+
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glEnable(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        return mips[0].texture;
+    }
+
+    // deletes the textures and framebuffers; call it while the GL context is still alive
+    void Clear()
+    {
+        for (Mip &mip : mips) {
+            glDeleteFramebuffers(1, &mip.framebuffer);
+            glDeleteTextures(1, &mip.texture);
+        }
+        mips.clear();
+    }
+
+    // the result is the sum of every level, this scales it back to the brightness of a single one
+    float Intensity() const
+    {
+        return mips.empty() ? 1.0f : 1.0f / mips.size();
+    }
+
+private:
+    Shader downsampleShader;
+    Shader upsampleShader;
+    UniformHandle uKaris;
+    UniformHandle uFilterRadius;
+};
+#endif
@@ -0,0 +1,58 @@
+#ifndef BRIGHT_PASS_H
+#define BRIGHT_PASS_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/fullscreen_quad.h>
+#include <learnopengl/render_targets.h>
+
+// Extracts the parts of the HDR frame bright enough to bloom into a smaller RGBA16F target (1/2 or 1/4
+// of the frame per axis). Every output pixel costs one bilinear fetch of the frame, which at half
+// resolution already averages the 2x2 texels it covers. The threshold has a soft knee, so colors fade
+// into the bloom instead of popping in when they cross it.
+class BrightPass
+{
+public:
+    float threshold = 0.9f;     // brightness where the bloom reaches full strength
+    float knee = 0.5f;          // width of the soft transition below threshold
+
+    BrightPass() : shader("resources/shaders/blur.vs", "resources/shaders/bright_pass.fs")
+    {
+        shader.use();
+        shader.setInt("scene", 0);
+        uThreshold = shader.uniform("threshold");
+        uKnee = shader.uniform("knee");
+    }
+
+    BrightPass(const BrightPass &) = delete;
+    BrightPass &operator=(const BrightPass &) = delete;
+
+    // filters sceneTexture into target, usually one from the RenderTargetPool.
+    // Restores the viewport; leaves the default framebuffer bound
+    void Render(unsigned int sceneTexture, const RenderTarget &target)
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+        glViewport(0, 0, target.width, target.height);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        shader.use();
+        shader.setFloat(uThreshold, threshold);
+        shader.setFloat(uKnee, knee);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, sceneTexture);
+        renderQuad();
+        glEnable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+
+private:
+    Shader shader;
+    UniformHandle uThreshold;
+    UniformHandle uKnee;
+};
+#endif
@@ -0,0 +1,99 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// camera pose at a point in time; yaw and pitch in degrees, as used by Camera
+struct CameraKeyframe {
+    float time;
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+};
+
+// A recorded camera flight, replayed by the benchmark. Each line of the file is one keyframe
+//     time  x y z  yaw pitch
+// with increasing times. Empty lines and lines starting with '#' are ignored.
+// Poses between keyframes are interpolated with a uniform Catmull-Rom spline, which passes through every keyframe.
+class CameraPath
+{
+public:
+    std::vector<CameraKeyframe> keyframes;
+
+    bool LoadFromFile(const std::string &filename)
+    {
+        std::ifstream in(filename);
+        if (!in) {
+            std::cout << "ERROR::CAMERA_PATH:: could not open " << filename << std::endl;
+            return false;
+        }
+        keyframes.clear();
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(in, line)) {
+            lineNumber++;
+            size_t start = line.find_first_not_of(" \t\r");
+            if (start == std::string::npos || line[start] == '#')
+                continue;
+            std::istringstream ls(line);
+            CameraKeyframe key;
+            ls >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch;
+            if (!ls || (!keyframes.empty() && key.time <= keyframes.back().time)) {
+                std::cout << "ERROR::CAMERA_PATH:: " << filename << ":" << lineNumber << " malformed keyframe" << std::endl;
+                continue;
+            }
+            keyframes.push_back(key);
+        }
+        return !keyframes.empty();
+    }
+
+    float Duration() const
+    {
+        return keyframes.empty() ? 0.0f : keyframes.back().time;
+    }
+
+    // pose at time t, clamped to the ends of the path
+    CameraKeyframe Evaluate(float t) const
+    {
+        if (keyframes.size() < 2 || t <= keyframes.front().time)
+            return keyframes.empty() ? CameraKeyframe() : keyframes.front();
+        if (t >= keyframes.back().time)
+            return keyframes.back();
+
+        unsigned int i = 1;
+        while (keyframes[i].time < t)
+            i++;
+        // the segment runs from p1 to p2; p0 and p3 are its neighbours, repeated at the ends
+        const CameraKeyframe &p0 = keyframes[i > 1 ? i - 2 : 0];
+        const CameraKeyframe &p1 = keyframes[i - 1];
+        const CameraKeyframe &p2 = keyframes[i];
+        const CameraKeyframe &p3 = keyframes[std::min<size_t>(i + 1, keyframes.size() - 1)];
+        float s = (t - p1.time) / (p2.time - p1.time);
+
+        CameraKeyframe result;
+        result.time = t;
+        result.position = catmullRom(p0.position, p1.position, p2.position, p3.position, s);
+        result.yaw = catmullRom(p0.yaw, p1.yaw, p2.yaw, p3.yaw, s);
+        result.pitch = catmullRom(p0.pitch, p1.pitch, p2.pitch, p3.pitch, s);
+        return result;
+    }
+
+private:
+    template <typename T>
+    static T catmullRom(const T &p0, const T &p1, const T &p2, const T &p3, float s)
+    {
+        float s2 = s * s;
+        float s3 = s2 * s;
+        return 0.5f * ((2.0f * p1) + (p2 - p0) * s + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * s2
+                       + (3.0f * p1 - p0 - 3.0f * p2 + p3) * s3);
+    }
+};
+#endif
@@ -0,0 +1,295 @@
+#ifndef CASCADED_SHADOWS_H
+#define CASCADED_SHADOWS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/scene.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/uniform_buffer.h>
+#include <learnopengl/clustered_lights.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// texture unit of the cascade array, after the cluster buffers
+const unsigned int SHADOW_MAP_UNIT = CLUSTER_INDICES_UNIT + 1;  // sampler2DArrayShadow shadowMap
+
+// layout (std140) uniform ShadowData
+struct ShadowData {
+    glm::mat4 lightSpace[4];    // world to shadow map clip space, per cascade
+    glm::vec4 splits;           // view depth where each cascade ends
+    glm::vec4 texelSizes;       // world units covered by one shadow map texel, per cascade
+    glm::vec4 params;           // cascade count (0 = no shadows), 1 / resolution, PCF radius in texels, depth bias
+};
+
+static_assert(sizeof(ShadowData) == 304, "ShadowData does not match the std140 layout");
+
+// Cascaded shadow maps for the directional light. The camera frustum up to shadowDistance is split into
+// cascadeCount slices, closer ones shorter (splitLambda blends logarithmic and uniform splits), and each
+// slice gets its own orthographic shadow map in a layer of one depth texture array.
+// Shadows stay still while the camera moves or turns: a cascade covers the bounding sphere of its slice,
+// whose size doesn't change with the camera's direction, and its origin is snapped to whole texels.
+// Casters are culled per cascade against the cascade's box, minus its near plane: with depth clamping,
+// anything between the slice and the light still lands on the map.
+//
+// With cacheStatic, the static casters of each cascade are rendered once into a second array and only copied
+// each frame, with the moving nodes drawn on top. For that a cascade covers its sphere plus a guard band and
+// stays put until the sphere leaves it; it is re-baked when it moves, when the light turns, or when the
+// Scene reports a static node was transformed.
+//
+//     shadows.Update(view, fovY, aspect, near, lightDirection);
+//     shadows.Render(scene, queue, frameUbo, cameraFrameData);  shadows.Bind();
+class CascadedShadowMaps
+{
+public:
+    static const int MAX_CASCADES = 4;
+
+    unsigned int depthArray = 0;
+    int resolution = 0;
+    int cascadeCount = 0;
+    float shadowDistance = 100.0f;  // view depth where shadows end
+    float splitLambda = 0.75f;      // 0 = uniform splits, 1 = logarithmic
+    float pcfRadius = 1.0f;         // in texels, the filter takes (2r+1)^2 taps
+    float depthBias = 0.0005f;      // in shadow map depth
+    bool cacheStatic = true;
+    float guardBand = 0.25f;        // extra cascade radius, as a fraction of the slice's sphere
+    unsigned int casterDraws = 0;   // of the last Render, over all cascades
+    unsigned int staticBakes = 0;   // cascades whose static casters were rendered, since the start
+
+    CascadedShadowMaps() : ubo(SHADOW_DATA_BINDING)
+    {
+        glGenFramebuffers(1, &framebuffer);
+        glGenFramebuffers(1, &staticFramebuffer);
+    }
+
+    CascadedShadowMaps(const CascadedShadowMaps &) = delete;
+    CascadedShadowMaps &operator=(const CascadedShadowMaps &) = delete;
+
+    // points shader's shadowMap sampler at its unit and binds its ShadowData block
+    static void SetupShader(Shader &shader)
+    {
+        shader.use();
+        shader.setInt("shadowMap", SHADOW_MAP_UNIT);
+        shader.bindUniformBlock("ShadowData", SHADOW_DATA_BINDING);
+    }
+
+    // (re)creates the depth array; call it when the resolution or the cascade count changes
+    void Resize(int resolution, int cascadeCount)
+    {
+        this->resolution = resolution;
+        this->cascadeCount = std::min(std::max(cascadeCount, 1), MAX_CASCADES);
+        glDeleteTextures(1, &depthArray);
+        glDeleteTextures(1, &staticArray);
+        depthArray = createArray(framebuffer);
+        // the static cache is made when first needed
+        staticArray = 0;
+        for (Cascade &cascade : cascades)
+            cascade.radius = 0.0f;
+    }
+
+    // fits the cascades to the camera (view matrix, vertical fov in radians, aspect, near and far plane) for a
+    // light shining along lightDirection, and uploads ShadowData. Shadows end at shadowDistance or the far
+    // plane, whichever is nearer. enabled = false makes the shaders skip shadows
+    void Update(const glm::mat4 &view, float fovY, float aspect, float nearPlane, float farPlane, const glm::vec3 &lightDirection,
+                bool enabled = true)
+    {
+        float distance = std::min(shadowDistance, farPlane);
+        ShadowData data;
+        data.params = glm::vec4(enabled ? (float) cascadeCount : 0.0f, 1.0f / resolution, pcfRadius, depthBias);
+        glm::vec3 direction = glm::normalize(lightDirection);
+        glm::vec3 up = std::fabs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        // a fixed origin, so snapping to texels means the same thing every frame
+        glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), direction, up);
+        glm::mat4 inverseView = glm::inverse(view);
+        float tanY = std::tan(fovY * 0.5f);
+        float tanX = tanY * aspect;
+        bool lightTurned = direction != lightDirectionBaked;
+        lightDirectionBaked = direction;
+
+        float sliceNear = nearPlane;
+        for (int i = 0; i < MAX_CASCADES; i++) {
+            if (i >= cascadeCount) {
+                data.lightSpace[i] = data.lightSpace[cascadeCount - 1];
+                data.splits[i] = data.splits[cascadeCount - 1];
+                data.texelSizes[i] = data.texelSizes[cascadeCount - 1];
+                continue;
+            }
+            float p = (i + 1) / (float) cascadeCount;
+            float logSplit = nearPlane * std::pow(distance / nearPlane, p);
+            float uniformSplit = nearPlane + (distance - nearPlane) * p;
+            float sliceFar = splitLambda * logSplit + (1.0f - splitLambda) * uniformSplit;
+
+            // the slice's bounding sphere is centered on the view axis, at the depth that makes the corners of
+            // both ends equally far away (clamped to the far end for wide slices)
+            float nearCorner = (tanX * tanX + tanY * tanY) * sliceNear * sliceNear;
+            float farCorner = (tanX * tanX + tanY * tanY) * sliceFar * sliceFar;
+            float centerDepth = std::min(0.5f * (sliceNear + sliceFar) + 0.5f * (farCorner - nearCorner) / (sliceFar - sliceNear),
+                                         sliceFar);
+            float radius = std::sqrt(farCorner + (sliceFar - centerDepth) * (sliceFar - centerDepth));
+            // quantized, so float noise doesn't change the texel size
+            radius = std::ceil(radius * 16.0f) / 16.0f;
+            glm::vec3 center = glm::vec3(inverseView * glm::vec4(0.0f, 0.0f, -centerDepth, 1.0f));
+            glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+
+            Cascade &cascade = cascades[i];
+            float cascadeRadius = cacheStatic ? radius * (1.0f + guardBand) : radius;
+            glm::vec3 offset = glm::abs(lightCenter - cascade.center) + radius;
+            bool contained = cascade.radius == cascadeRadius &&
+                             offset.x <= cascadeRadius && offset.y <= cascadeRadius && offset.z <= cascadeRadius;
+            if (!cacheStatic || lightTurned || !contained) {
+                float texel = 2.0f * cascadeRadius / resolution;
+                cascade.center = glm::vec3(std::floor(lightCenter.x / texel) * texel,
+                                           std::floor(lightCenter.y / texel) * texel, lightCenter.z);
+                cascade.radius = cascadeRadius;
+                cascade.view = lightView;
+                cascade.projection = glm::ortho(cascade.center.x - cascadeRadius, cascade.center.x + cascadeRadius,
+                                                cascade.center.y - cascadeRadius, cascade.center.y + cascadeRadius,
+                                                -cascade.center.z - cascadeRadius, -cascade.center.z + cascadeRadius);
+                cascade.staticBaked = false;
+            }
+            data.lightSpace[i] = cascade.projection * cascade.view;
+            data.splits[i] = sliceFar;
+            data.texelSizes[i] = 2.0f * cascade.radius / resolution;
+            sliceNear = sliceFar;
+        }
+        ubo.update(data);
+    }
+
+    // draws the SHADER_DEPTH variant of scene into every cascade, using frameUbo to hand each cascade's
+    // matrices to the depth shaders; camera is restored afterwards. Leaves the default framebuffer bound
+    void Render(Scene &scene, RenderQueue &queue, const UniformBuffer<FrameData> &frameUbo, const FrameData &camera)
+    {
+        if (cacheStatic && staticArray == 0)
+            staticArray = createArray(staticFramebuffer);
+        if (scene.staticVersion != staticVersionBaked) {
+            staticVersionBaked = scene.staticVersion;
+            for (Cascade &cascade : cascades)
+                cascade.staticBaked = false;
+        }
+
+        glViewport(0, 0, resolution, resolution);
+        // casters in front of the near plane are flattened onto it instead of clipped
+        glEnable(GL_DEPTH_CLAMP);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+        casterDraws = 0;
+        for (int i = 0; i < cascadeCount; i++) {
+            Cascade &cascade = cascades[i];
+            FrameData frameData = camera;
+            frameData.projection = cascade.projection;
+            frameData.view = cascade.view;
+            frameUbo.update(frameData);
+            Frustum frustum = Frustum::FromMatrix(cascade.projection * cascade.view);
+            frustum.planes[4] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);   // no near plane, see the class comment
+
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthArray, 0, i);
+            if (!cacheStatic) {
+                glClear(GL_DEPTH_BUFFER_BIT);
+                drawCasters(scene, queue, frustum, camera, NODES_ALL);
+                continue;
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, staticFramebuffer);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticArray, 0, i);
+            if (!cascade.staticBaked) {
+                glClear(GL_DEPTH_BUFFER_BIT);
+                drawCasters(scene, queue, frustum, camera, NODES_STATIC);
+                cascade.staticBaked = true;
+                staticBakes++;
+            }
+            // the cached static depth, then the moving casters on top of it
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFramebuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+            glBlitFramebuffer(0, 0, resolution, resolution, 0, 0, resolution, resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            drawCasters(scene, queue, frustum, camera, NODES_MOVING);
+        }
+        glPolygonOffset(0.0f, 0.0f);
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glDisable(GL_DEPTH_CLAMP);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        frameUbo.update(camera);
+    }
+
+    // binds the cascade array to SHADOW_MAP_UNIT for the lighting passes
+    void Bind() const
+    {
+        glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // call it while the GL context is still alive
+    void Clear()
+    {
+        glDeleteTextures(1, &depthArray);
+        glDeleteTextures(1, &staticArray);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteFramebuffers(1, &staticFramebuffer);
+        depthArray = staticArray = framebuffer = staticFramebuffer = 0;
+    }
+
+private:
+    struct Cascade {
+        glm::mat4 view = glm::mat4(1.0f);
+        glm::mat4 projection = glm::mat4(1.0f);
+        glm::vec3 center = glm::vec3(0.0f);     // in light view space, snapped to texels
+        float radius = 0.0f;                    // 0 until the cascade was first fitted
+        bool staticBaked = false;               // the static array holds this cascade's static casters
+    };
+
+    UniformBuffer<ShadowData> ubo;
+    unsigned int framebuffer = 0;
+    unsigned int staticArray = 0;
+    unsigned int staticFramebuffer = 0;
+    Cascade cascades[MAX_CASCADES];
+    glm::vec3 lightDirectionBaked = glm::vec3(0.0f);
+    unsigned int staticVersionBaked = 0;
+
+    // a cascadeCount layer depth array attached (layer 0) to target
+    unsigned int createArray(unsigned int target) const
+    {
+        unsigned int array;
+        glGenTextures(1, &array);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, cascadeCount, 0,
+                     GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+        // depth comparison in the sampler, so every bilinear tap is already a 2x2 PCF
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        // outside the map is unshadowed
+        const float border[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, target);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, array, 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::SHADOWS:: cascade framebuffer not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return array;
+    }
+
+    void drawCasters(Scene &scene, RenderQueue &queue, const Frustum &frustum, const FrameData &camera,
+                     SceneNodeFilter filter)
+    {
+        queue.Clear();
+        // full detail casters: a cached cascade would otherwise keep the LOD of the frame it was baked in
+        scene.Submit(queue, frustum, glm::vec3(camera.viewPosition), SHADER_DEPTH, filter, nullptr, false);
+        queue.Sort();
+        queue.Execute(true);
+        casterDraws += queue.stats.draws;
+    }
+};
+#endif
@@ -0,0 +1,236 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/light_source.h>
+#include <learnopengl/uniform_buffer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// texture units of the three light buffers, right after the material slots
+enum ClusterTextureUnit {
+    CLUSTER_LIGHTS_UNIT  = SLOT_COUNT,      // samplerBuffer pointLightData, 4 RGBA32F texels per light
+    CLUSTER_RANGES_UNIT  = SLOT_COUNT + 1,  // usamplerBuffer clusterLights, RG32UI (first index, count) per cluster
+    CLUSTER_INDICES_UNIT = SLOT_COUNT + 2   // usamplerBuffer lightIndices, R32UI light numbers
+};
+
+// layout (std140) uniform ClusterData
+struct ClusterData {
+    glm::uvec4 grid;    // tiles x, tiles y, depth slices, unused
+    glm::vec4 params;   // slice = log(view depth) * x + y; tile = pixel * zw
+};
+
+static_assert(sizeof(ClusterData) == 32, "ClusterData does not match the std140 layout");
+
+// Clustered light culling for the forward path. The view frustum is cut into TILES_X x TILES_Y screen tiles
+// and SLICES depth slices, spaced exponentially so near clusters are not needlessly deep. Every frame the
+// CPU lists the lights whose sphere overlaps each cluster; a fragment then only evaluates the lights of its
+// own cluster. The lists live in buffer textures, which GL 3.3 has, so any number of lights works without
+// recompiling the shader.
+class ClusteredLights
+{
+public:
+    static const unsigned int TILES_X = 16;
+    static const unsigned int TILES_Y = 9;
+    static const unsigned int SLICES = 24;
+    static const unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+    unsigned int lightCount = 0;    // of the last Build
+    unsigned int indexCount = 0;    // light references over all clusters
+    unsigned int maxClusterLights = 0;
+
+    ClusteredLights() : ubo(CLUSTER_DATA_BINDING)
+    {
+        lightBuffer = createBuffer(lightTexture, GL_RGBA32F);
+        rangeBuffer = createBuffer(rangeTexture, GL_RG32UI);
+        indexBuffer = createBuffer(indexTexture, GL_R32UI);
+    }
+
+    ClusteredLights(const ClusteredLights &) = delete;
+    ClusteredLights &operator=(const ClusteredLights &) = delete;
+
+    // points shader's light samplers at their units and binds its ClusterData block
+    static void SetupShader(Shader &shader)
+    {
+        shader.use();
+        shader.setInt("pointLightData", CLUSTER_LIGHTS_UNIT);
+        shader.setInt("clusterLights", CLUSTER_RANGES_UNIT);
+        shader.setInt("lightIndices", CLUSTER_INDICES_UNIT);
+        shader.bindUniformBlock("ClusterData", CLUSTER_DATA_BINDING);
+    }
+
+    // assigns lights to clusters for a camera with the given view matrix and a symmetric perspective
+    // projection (vertical fov in radians), rendering into width x height pixels, and uploads the result
+    void Build(const std::vector<PointLightSource> &lights, const glm::mat4 &view, float fovY, float aspect,
+               float nearPlane, float farPlane, int width, int height)
+    {
+        lightCount = lights.size();
+        float sliceScale = SLICES / std::log(farPlane / nearPlane);
+        float sliceBias = -std::log(nearPlane) * sliceScale;
+        float tanY = std::tan(fovY * 0.5f);
+        float tanX = tanY * aspect;
+
+        // the clusters each light touches, as a box of tile and slice ranges
+        boxes.resize(lights.size());
+        counts.assign(CLUSTER_COUNT, 0u);
+        for (unsigned int i = 0; i < lights.size(); i++) {
+            ClusterBox &box = boxes[i];
+            box.empty = !clusterBox(glm::vec3(view * glm::vec4(lights[i].position, 1.0f)), lights[i].radius,
+                                    tanX, tanY, nearPlane, farPlane, sliceScale, sliceBias, box);
+            if (box.empty)
+                continue;
+            for (unsigned int z = box.min[2]; z <= box.max[2]; z++)
+                for (unsigned int y = box.min[1]; y <= box.max[1]; y++)
+                    for (unsigned int x = box.min[0]; x <= box.max[0]; x++)
+                        counts[index(x, y, z)]++;
+        }
+
+        // prefix sums give every cluster its slice of the index list
+        ranges.resize(CLUSTER_COUNT * 2);
+        indexCount = 0;
+        maxClusterLights = 0;
+        for (unsigned int c = 0; c < CLUSTER_COUNT; c++) {
+            ranges[2 * c] = indexCount;
+            ranges[2 * c + 1] = 0;
+            indexCount += counts[c];
+            maxClusterLights = std::max(maxClusterLights, counts[c]);
+        }
+        indices.resize(std::max(indexCount, 1u));
+        for (unsigned int i = 0; i < lights.size(); i++) {
+            const ClusterBox &box = boxes[i];
+            if (box.empty)
+                continue;
+            for (unsigned int z = box.min[2]; z <= box.max[2]; z++)
+                for (unsigned int y = box.min[1]; y <= box.max[1]; y++)
+                    for (unsigned int x = box.min[0]; x <= box.max[0]; x++) {
+                        unsigned int c = index(x, y, z);
+                        indices[ranges[2 * c] + ranges[2 * c + 1]++] = i;
+                    }
+        }
+
+        upload(lightBuffer, lights.empty() ? nullptr : lights.data(), std::max<size_t>(lights.size(), 1) * sizeof(PointLightSource));
+        upload(rangeBuffer, ranges.data(), ranges.size() * sizeof(unsigned int));
+        upload(indexBuffer, indices.data(), indices.size() * sizeof(unsigned int));
+
+        ClusterData data;
+        data.grid = glm::uvec4(TILES_X, TILES_Y, SLICES, 0);
+        data.params = glm::vec4(sliceScale, sliceBias, (float) TILES_X / width, (float) TILES_Y / height);
+        ubo.update(data);
+    }
+
+    // binds the buffers to their units for the scene pass
+    void Bind() const
+    {
+        glActiveTexture(GL_TEXTURE0 + CLUSTER_LIGHTS_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+        glActiveTexture(GL_TEXTURE0 + CLUSTER_RANGES_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, rangeTexture);
+        glActiveTexture(GL_TEXTURE0 + CLUSTER_INDICES_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // call it while the GL context is still alive
+    void Clear()
+    {
+        unsigned int buffers[3] = {lightBuffer, rangeBuffer, indexBuffer};
+        unsigned int textures[3] = {lightTexture, rangeTexture, indexTexture};
+        glDeleteBuffers(3, buffers);
+        glDeleteTextures(3, textures);
+        lightBuffer = rangeBuffer = indexBuffer = lightTexture = rangeTexture = indexTexture = 0;
+    }
+
+private:
+    struct ClusterBox {
+        unsigned int min[3], max[3];
+        bool empty;
+    };
+
+    UniformBuffer<ClusterData> ubo;
+    unsigned int lightBuffer = 0, rangeBuffer = 0, indexBuffer = 0;
+    unsigned int lightTexture = 0, rangeTexture = 0, indexTexture = 0;
+    std::vector<ClusterBox> boxes;
+    std::vector<unsigned int> counts;
+    std::vector<unsigned int> ranges;
+    std::vector<unsigned int> indices;
+
+    static unsigned int index(unsigned int x, unsigned int y, unsigned int z)
+    {
+        return x + TILES_X * (y + TILES_Y * z);
+    }
+
+    // conservative cluster range of a sphere at view space center; false if it lies outside the frustum.
+    // The tile range bounds the screen projection of the sphere's view space bounding box
+    static bool clusterBox(const glm::vec3 &center, float radius, float tanX, float tanY, float nearPlane,
+                           float farPlane, float sliceScale, float sliceBias, ClusterBox &box)
+    {
+        float zNear = -center.z - radius;   // view depth, positive in front of the camera
+        float zFar = -center.z + radius;
+        if (zFar < nearPlane || zNear > farPlane)
+            return false;
+        box.min[2] = sliceOf(std::max(zNear, nearPlane), sliceScale, sliceBias);
+        box.max[2] = sliceOf(std::min(zFar, farPlane), sliceScale, sliceBias);
+
+        // in x and y the box's extremes are seen from its nearest depth, unless it reaches behind the near plane
+        float depth = std::max(zNear, nearPlane);
+        float ndc[4] = {-1.0f, -1.0f, 1.0f, 1.0f};  // min x, min y, max x, max y
+        if (zNear > nearPlane) {
+            // the far depth is the one that makes a negative coordinate's projection largest (closest to 0)
+            float xs[2] = {center.x - radius, center.x + radius};
+            float ys[2] = {center.y - radius, center.y + radius};
+            ndc[0] = xs[0] / ((xs[0] < 0.0f ? depth : zFar) * tanX);
+            ndc[2] = xs[1] / ((xs[1] > 0.0f ? depth : zFar) * tanX);
+            ndc[1] = ys[0] / ((ys[0] < 0.0f ? depth : zFar) * tanY);
+            ndc[3] = ys[1] / ((ys[1] > 0.0f ? depth : zFar) * tanY);
+        }
+        if (ndc[0] > 1.0f || ndc[2] < -1.0f || ndc[1] > 1.0f || ndc[3] < -1.0f)
+            return false;
+        box.min[0] = tileOf(ndc[0], TILES_X);
+        box.max[0] = tileOf(ndc[2], TILES_X);
+        box.min[1] = tileOf(ndc[1], TILES_Y);
+        box.max[1] = tileOf(ndc[3], TILES_Y);
+        return true;
+    }
+
+    static unsigned int sliceOf(float depth, float sliceScale, float sliceBias)
+    {
+        float slice = std::log(depth) * sliceScale + sliceBias;
+        return (unsigned int) std::min(std::max(slice, 0.0f), (float) (SLICES - 1));
+    }
+
+    static unsigned int tileOf(float ndc, unsigned int tiles)
+    {
+        float tile = (ndc * 0.5f + 0.5f) * tiles;
+        return (unsigned int) std::min(std::max(tile, 0.0f), (float) (tiles - 1));
+    }
+
+    static unsigned int createBuffer(unsigned int &texture, GLenum format)
+    {
+        unsigned int buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        return buffer;
+    }
+
+    // reallocating the store every frame lets the driver hand out fresh memory instead of waiting for the GPU
+    static void upload(unsigned int buffer, const void *data, size_t size)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+#endif
@@ -0,0 +1,69 @@
+#ifndef COMPUTE_BLUR_H
+#define COMPUTE_BLUR_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/compute_shader.h>
+#include <learnopengl/gaussian_kernel.h>
+
+// largest kernel radius blur.comp accepts, must match MAX_RADIUS there
+const int COMPUTE_BLUR_MAX_RADIUS = 32;
+
+// Separable Gaussian blur on GL 4.3 compute shaders (blur.comp), the counterpart of the blur.fs
+// ping-pong. Each pass reads every texel once into shared memory, so the texture traffic no longer
+// grows with the kernel radius. Only construct it when GLCompute::Supported().
+class ComputeBlur
+{
+public:
+    static const unsigned int TILE_SIZE = 128;  // local_size_x of blur.comp
+
+    ComputeBlur() : shader("resources/shaders/blur.comp")
+    {
+        shader.use();
+        shader.setInt("image", 0);
+        uHorizontal = shader.uniform("horizontal");
+        uRadius = shader.uniform("radius");
+        uWeights = shader.uniform("weights");
+    }
+
+    // alternates horizontal and vertical passes like the fragment blur: source -> targets[1] -> targets[0] -> ...
+    // targets must be RGBA16F textures of width x height. Returns the texture holding the result
+    unsigned int Blur(unsigned int source, const unsigned int targets[2], int width, int height,
+                      unsigned int passes, float sigma)
+    {
+        const GLCompute &gl = GLCompute::Functions();
+        shader.use();
+        if (sigma != uploadedSigma) {
+            GaussianKernel kernel = GaussianKernel::Discrete(sigma, COMPUTE_BLUR_MAX_RADIUS);
+            shader.setInt(uRadius, kernel.TapCount() - 1);
+            shader.setFloatArray(uWeights, kernel.weights.data(), kernel.TapCount());
+            uploadedSigma = sigma;
+        }
+
+        bool horizontal = true;
+        unsigned int input = source;
+        glActiveTexture(GL_TEXTURE0);
+        for (unsigned int i = 0; i < passes; i++) {
+            unsigned int output = targets[horizontal];
+            shader.setBool(uHorizontal, horizontal);
+            glBindTexture(GL_TEXTURE_2D, input);
+            gl.bindImageTexture(0, output, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+            int length = horizontal ? width : height;
+            int lines = horizontal ? height : width;
+            shader.dispatch((length + TILE_SIZE - 1) / TILE_SIZE, lines);
+            // the next pass samples what this one wrote
+            gl.memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            input = output;
+            horizontal = !horizontal;
+        }
+        return input;
+    }
+
+private:
+    ComputeShader shader;
+    UniformHandle uHorizontal;
+    UniformHandle uRadius;
+    UniformHandle uWeights;
+    float uploadedSigma = -1.0f;
+};
+#endif
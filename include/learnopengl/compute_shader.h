@@ -0,0 +1,92 @@
+#ifndef COMPUTE_SHADER_H
+#define COMPUTE_SHADER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader_m.h>
+
+#include <string>
+#include <iostream>
+#include <common.h>
+
+// glad in libs/ is generated for GL 3.3 core, so the few GL 4.3 entry points the compute path needs
+// are loaded here by hand. They stay null on older contexts; check GLCompute::Supported() first.
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#endif
+#ifndef GL_TEXTURE_FETCH_BARRIER_BIT
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#endif
+
+struct GLCompute
+{
+    typedef void (APIENTRYP DispatchComputeProc)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+    typedef void (APIENTRYP BindImageTextureProc)(GLuint unit, GLuint texture, GLint level, GLboolean layered,
+                                                  GLint layer, GLenum access, GLenum format);
+    typedef void (APIENTRYP MemoryBarrierProc)(GLbitfield barriers);
+
+    DispatchComputeProc dispatchCompute = nullptr;
+    BindImageTextureProc bindImageTexture = nullptr;
+    MemoryBarrierProc memoryBarrier = nullptr;
+
+    static GLCompute &Functions()
+    {
+        static GLCompute functions;
+        return functions;
+    }
+
+    // loads the entry points if the current context is GL 4.3 or newer; call it after gladLoadGLLoader
+    static bool Load(GLADloadproc load)
+    {
+        GLCompute &f = Functions();
+        if (GLVersion.major < 4 || (GLVersion.major == 4 && GLVersion.minor < 3))
+            return false;
+        f.dispatchCompute = (DispatchComputeProc) load("glDispatchCompute");
+        f.bindImageTexture = (BindImageTextureProc) load("glBindImageTexture");
+        f.memoryBarrier = (MemoryBarrierProc) load("glMemoryBarrier");
+        return Supported();
+    }
+
+    static bool Supported()
+    {
+        const GLCompute &f = Functions();
+        return f.dispatchCompute && f.bindImageTexture && f.memoryBarrier;
+    }
+};
+
+// a program made of a single compute shader. Uniforms work exactly as with Shader
+class ComputeShader : public Shader
+{
+public:
+    explicit ComputeShader(const char *computePath)
+    {
+        std::string path(computePath);
+        appendShaderFolderIfNotPresent(path);
+        std::string code = readFileContents(path);
+        if (code.empty())
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+        const char *cShaderCode = code.c_str();
+
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, NULL);
+        glCompileShader(compute);
+        checkCompileErrors(compute, "COMPUTE");
+        ID = glCreateProgram();
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        glDeleteShader(compute);
+
+        introspectUniforms();
+    }
+
+    // runs groupsX * groupsY * groupsZ work groups; the program must be in use
+    void dispatch(GLuint groupsX, GLuint groupsY, GLuint groupsZ = 1) const
+    {
+        GLCompute::Functions().dispatchCompute(groupsX, groupsY, groupsZ);
+    }
+};
+#endif
@@ -0,0 +1,257 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/fullscreen_quad.h>
+#include <learnopengl/render_targets.h>
+#include <learnopengl/uniform_buffer.h>
+#include <learnopengl/light_source.h>
+#include <learnopengl/cascaded_shadows.h>
+#include <learnopengl/point_shadows.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// The deferred shading path. The scene is drawn once into a G-buffer
+//     0: albedo rgb, specular map a (RGBA8) | 1: normal (RGBA16F) | depth (24 bit texture)
+// and then lit into the HDR target: one full-screen pass for the lights of LightData, then every
+// PointLightSource as an instanced sphere covering the pixels it can reach. A pixel covered by no
+// light volume costs nothing however many lights there are, so hundreds of small lights are cheap.
+//
+//     deferred.Resize(w, h);  deferred.BeginGeometry();  ...draw with the SHADER_GBUFFER variant...
+//     deferred.Light(hdrTarget, projection, view, lights); ...forward passes on top...
+class DeferredRenderer
+{
+public:
+    unsigned int framebuffer = 0;
+    unsigned int albedoSpec = 0;
+    unsigned int normal = 0;
+    unsigned int depth = 0;
+    int width = 0, height = 0;
+    float shininess = 32.0f;    // the G-buffer has no room for it, every material uses this one
+
+    DeferredRenderer()
+        : globalShader("resources/shaders/blur.vs", "resources/shaders/deferred_global.fs"),
+          pointShader("resources/shaders/deferred_point.vs", "resources/shaders/deferred_point.fs")
+    {
+        for (Shader *shader : {&globalShader, &pointShader}) {
+            shader->use();
+            shader->setInt("gAlbedoSpec", 0);
+            shader->setInt("gNormal", 1);
+            shader->setInt("gDepth", 2);
+            shader->bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+        }
+        globalShader.bindUniformBlock("LightData", LIGHT_DATA_BINDING);
+        CascadedShadowMaps::SetupShader(globalShader);
+        PointShadowAtlas::SetupShader(pointShader);
+        uGlobalInverseViewProjection = globalShader.uniform("inverseViewProjection");
+        uGlobalShininess = globalShader.uniform("shininess");
+        uPointInverseViewProjection = pointShader.uniform("inverseViewProjection");
+        uPointInverseScreenSize = pointShader.uniform("inverseScreenSize");
+        uPointShininess = pointShader.uniform("shininess");
+        setupVolume();
+    }
+
+    DeferredRenderer(const DeferredRenderer &) = delete;
+    DeferredRenderer &operator=(const DeferredRenderer &) = delete;
+
+    // (re)creates the G-buffer; call it when the render resolution changes
+    void Resize(int width, int height)
+    {
+        clearGBuffer();
+        this->width = width;
+        this->height = height;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        albedoSpec = createTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpec, 0);
+        normal = createTexture(GL_RGBA16F, GL_RGBA, GL_FLOAT);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+        // same format as the depth of the HDR target, so it can be blitted there
+        depth = createTexture(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        const GLenum attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::DEFERRED:: G-buffer not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // binds and clears the G-buffer for the geometry pass
+    void BeginGeometry()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // lights the G-buffer into target, which must be as large as the G-buffer and have depth. Copies the
+    // scene depth into target first, so forward passes drawn afterwards are depth tested against the scene.
+    // Leaves target bound
+    void Light(const RenderTarget &target, const glm::mat4 &projection, const glm::mat4 &view,
+               const std::vector<PointLightSource> &lights)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.framebuffer);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+        glViewport(0, 0, width, height);
+
+        glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, albedoSpec);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, normal);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, depth);
+
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        globalShader.use();
+        globalShader.setMat4(uGlobalInverseViewProjection, inverseViewProjection);
+        globalShader.setFloat(uGlobalShininess, shininess);
+        renderQuad();
+
+        if (!lights.empty()) {
+            uploadLights(lights);
+            // back faces with GL_GEQUAL: a pixel is lit if the scene there lies in front of the volume's far side.
+            // That keeps working with the camera inside a volume, where the front faces are clipped away
+            glEnable(GL_DEPTH_TEST);
+            glDepthFunc(GL_GEQUAL);
+            glDepthMask(GL_FALSE);
+            glEnable(GL_DEPTH_CLAMP);
+            glCullFace(GL_FRONT);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            pointShader.use();
+            pointShader.setMat4(uPointInverseViewProjection, inverseViewProjection);
+            pointShader.setVec2(uPointInverseScreenSize, glm::vec2(1.0f / width, 1.0f / height));
+            pointShader.setFloat(uPointShininess, shininess);
+            glBindVertexArray(volumeVAO);
+            glDrawElementsInstanced(GL_TRIANGLES, volumeIndexCount, GL_UNSIGNED_INT, 0, lights.size());
+            glBindVertexArray(0);
+            glCullFace(GL_BACK);
+            glDisable(GL_DEPTH_CLAMP);
+            glDepthMask(GL_TRUE);
+            glDepthFunc(GL_LESS);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        }
+        glEnable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // call it while the GL context is still alive
+    void Clear()
+    {
+        clearGBuffer();
+        glDeleteVertexArrays(1, &volumeVAO);
+        glDeleteBuffers(1, &volumeVBO);
+        glDeleteBuffers(1, &volumeEBO);
+        glDeleteBuffers(1, &lightVBO);
+        volumeVAO = volumeVBO = volumeEBO = lightVBO = 0;
+    }
+
+private:
+    Shader globalShader;
+    Shader pointShader;
+    UniformHandle uGlobalInverseViewProjection;
+    UniformHandle uGlobalShininess;
+    UniformHandle uPointInverseViewProjection;
+    UniformHandle uPointInverseScreenSize;
+    UniformHandle uPointShininess;
+    unsigned int volumeVAO = 0, volumeVBO = 0, volumeEBO = 0;
+    unsigned int volumeIndexCount = 0;
+    unsigned int lightVBO = 0;
+    unsigned int lightCapacity = 0;
+
+    unsigned int createTexture(GLenum internalFormat, GLenum format, GLenum type)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    void clearGBuffer()
+    {
+        if (framebuffer)
+            glDeleteFramebuffers(1, &framebuffer);
+        unsigned int textures[3] = {albedoSpec, normal, depth};
+        glDeleteTextures(3, textures);
+        framebuffer = albedoSpec = normal = depth = 0;
+    }
+
+    // a UV sphere of 12 slices and 8 stacks. Its flat faces cut inside the sphere through its vertices,
+    // so it is scaled up until they enclose the unit sphere
+    void setupVolume()
+    {
+        const unsigned int slices = 12, stacks = 8;
+        const float pi = 3.14159265f;
+        float enclose = 1.0f / (std::cos(pi / slices) * std::cos(pi / (2 * stacks)));
+        std::vector<glm::vec3> vertices;
+        for (unsigned int stack = 0; stack <= stacks; stack++) {
+            float phi = pi * stack / stacks;
+            for (unsigned int slice = 0; slice <= slices; slice++) {
+                float theta = 2.0f * pi * slice / slices;
+                vertices.push_back(enclose * glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta)));
+            }
+        }
+        // counter-clockwise seen from outside
+        std::vector<unsigned int> indices;
+        for (unsigned int stack = 0; stack < stacks; stack++) {
+            for (unsigned int slice = 0; slice < slices; slice++) {
+                unsigned int a = stack * (slices + 1) + slice;
+                unsigned int b = a + slices + 1;
+                indices.insert(indices.end(), {a, a + 1, b, b, a + 1, b + 1});
+            }
+        }
+        volumeIndexCount = indices.size();
+
+        glGenVertexArrays(1, &volumeVAO);
+        glGenBuffers(1, &volumeVBO);
+        glGenBuffers(1, &volumeEBO);
+        glGenBuffers(1, &lightVBO);
+        glBindVertexArray(volumeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, volumeVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, volumeEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+        // a PointLightSource is four vec4s, one attribute each
+        glBindBuffer(GL_ARRAY_BUFFER, lightVBO);
+        for (unsigned int i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(1 + i);
+            glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, sizeof(PointLightSource), (void*)(i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(1 + i, 1);
+        }
+        glBindVertexArray(0);
+    }
+
+    // streams the lights into the instance buffer, growing it when needed
+    void uploadLights(const std::vector<PointLightSource> &lights)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, lightVBO);
+        if (lights.size() > lightCapacity) {
+            lightCapacity = lights.size();
+            glBufferData(GL_ARRAY_BUFFER, lightCapacity * sizeof(PointLightSource), NULL, GL_DYNAMIC_DRAW);
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, 0, lights.size() * sizeof(PointLightSource), lights.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+#endif
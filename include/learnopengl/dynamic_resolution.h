@@ -0,0 +1,60 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <algorithm>
+#include <cmath>
+
+// Picks the render scale that keeps the GPU frame time under a budget.
+// Feed it every new GPU frame time the Profiler resolves. GPU cost grows with the pixel count, so the
+// scale that would hit the target is scale * sqrt(target / time). Three things keep it from oscillating:
+//  - nothing changes while the smoothed time stays between lowerBound and upperBound of the budget,
+//  - scales are multiples of step, so every size the RenderTargetPool sees is reused rather than reallocated,
+//  - after a change the next settleSamples times are skipped, as they were still measured at the old scale.
+// It shrinks by up to a quarter at once but grows a single step at a time, so a heavy view is left quickly
+// and returned to carefully.
+class DynamicResolution
+{
+public:
+    bool enabled = false;
+    float budgetMs = 16.6f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float lowerBound = 0.75f;   // fractions of the budget
+    float upperBound = 0.95f;
+    float step = 0.05f;
+    unsigned int settleSamples = 8;
+
+    // returns the scale to render the next frame at
+    float Update(float scale, float gpuFrameMs)
+    {
+        smoothedMs = smoothedMs == 0.0f ? gpuFrameMs : smoothedMs * 0.8f + gpuFrameMs * 0.2f;
+        if (cooldown > 0) {
+            cooldown--;
+            return scale;
+        }
+        if (smoothedMs <= 0.0f || (smoothedMs >= budgetMs * lowerBound && smoothedMs <= budgetMs * upperBound))
+            return scale;
+
+        float targetMs = budgetMs * 0.5f * (lowerBound + upperBound);
+        float desired = scale * std::sqrt(targetMs / smoothedMs);
+        desired = std::min(std::max(desired, scale * 0.75f), scale + step);
+        desired = std::round(desired / step) * step;
+        desired = std::min(std::max(desired, minScale), maxScale);
+        if (std::fabs(desired - scale) < step * 0.5f)
+            return scale;
+        // the average so far describes the old resolution
+        smoothedMs = 0.0f;
+        cooldown = settleSamples;
+        return desired;
+    }
+
+    float SmoothedMs() const
+    {
+        return smoothedMs;
+    }
+
+private:
+    float smoothedMs = 0.0f;
+    unsigned int cooldown = 0;
+};
+#endif
@@ -0,0 +1,109 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+// view frustum as six planes (a, b, c, d) with normals pointing inside: a*x + b*y + c*z + d >= 0 is inside
+struct Frustum
+{
+    glm::vec4 planes[6]; // left, right, bottom, top, near, far
+
+    // extracts the planes from a projection * view (or projection * view * model) matrix (Gribb & Hartmann)
+    static Frustum FromMatrix(const glm::mat4 &m)
+    {
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        Frustum frustum;
+        frustum.planes[0] = row3 + row0;
+        frustum.planes[1] = row3 - row0;
+        frustum.planes[2] = row3 + row1;
+        frustum.planes[3] = row3 - row1;
+        frustum.planes[4] = row3 + row2;
+        frustum.planes[5] = row3 - row2;
+        for (glm::vec4 &plane : frustum.planes)
+            plane /= glm::length(glm::vec3(plane));
+        return frustum;
+    }
+
+    bool IntersectsSphere(const glm::vec3 &center, float radius) const
+    {
+        for (const glm::vec4 &plane : planes)
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        return true;
+    }
+
+    // tests the corner of the box that lies furthest along each plane normal
+    bool IntersectsAABB(const glm::vec3 &min, const glm::vec3 &max) const
+    {
+        for (const glm::vec4 &plane : planes) {
+            glm::vec3 p(plane.x >= 0.0f ? max.x : min.x,
+                        plane.y >= 0.0f ? max.y : min.y,
+                        plane.z >= 0.0f ? max.z : min.z);
+            if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+
+// tests count spheres stored as separate x, y, z, radius arrays against the frustum and writes
+// 1 (visible) or 0 (culled) into visible. The SoA layout lets SSE test 4 (AVX: 8) spheres per plane at once.
+inline void CullSpheres(const Frustum &frustum, const float *x, const float *y, const float *z, const float *radius,
+                        unsigned int count, unsigned char *visible)
+{
+    unsigned int i = 0;
+#if defined(__AVX__)
+    __m256 zero8 = _mm256_setzero_ps();
+    for (; i + 8 <= count; i += 8) {
+        __m256 cx = _mm256_loadu_ps(x + i);
+        __m256 cy = _mm256_loadu_ps(y + i);
+        __m256 cz = _mm256_loadu_ps(z + i);
+        __m256 negR = _mm256_sub_ps(zero8, _mm256_loadu_ps(radius + i));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const glm::vec4 &plane : frustum.planes) {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), cx),
+                                                   _mm256_mul_ps(_mm256_set1_ps(plane.y), cy)),
+                                     _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), cz),
+                                                   _mm256_set1_ps(plane.w)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for (int k = 0; k < 8; k++)
+            visible[i + k] = (mask >> k) & 1;
+    }
+#endif
+#if defined(__SSE__) || defined(_M_X64) || defined(__AVX__)
+    __m128 zero4 = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        __m128 cx = _mm_loadu_ps(x + i);
+        __m128 cy = _mm_loadu_ps(y + i);
+        __m128 cz = _mm_loadu_ps(z + i);
+        __m128 negR = _mm_sub_ps(zero4, _mm_loadu_ps(radius + i));
+        __m128 inside = _mm_cmpeq_ps(zero4, zero4);
+        for (const glm::vec4 &plane : frustum.planes) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx),
+                                             _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+                                  _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz),
+                                             _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int k = 0; k < 4; k++)
+            visible[i + k] = (mask >> k) & 1;
+    }
+#endif
+    // remainder (and the whole array on targets without SSE)
+    for (; i < count; i++)
+        visible[i] = frustum.IntersectsSphere(glm::vec3(x[i], y[i], z[i]), radius[i]) ? 1 : 0;
+}
+#endif
@@ -0,0 +1,74 @@
+#ifndef GAUSSIAN_KERNEL_H
+#define GAUSSIAN_KERNEL_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// largest number of taps per side blur.fs accepts, must match MAX_TAPS there
+const int GAUSSIAN_MAX_TAPS = 16;
+
+// One dimensional Gaussian blur kernel for a separable blur that relies on bilinear filtering:
+// sampling between two texels at the right spot returns their weighted average, so two discrete taps
+// cost a single texture fetch. A kernel of radius r needs 1 + 2 * ceil(r / 2) fetches instead of 1 + 2 * r.
+// weights[0]/offsets[0] is the center tap; every other tap is sampled at +offset and -offset (in texels).
+struct GaussianKernel
+{
+    std::vector<float> weights;
+    std::vector<float> offsets;
+
+    // kernel covering 3 sigma on each side, clamped to what the shader accepts
+    static GaussianKernel Linear(float sigma)
+    {
+        sigma = std::max(sigma, 0.1f);
+        int radius = std::min((int)std::ceil(3.0f * sigma), 2 * (GAUSSIAN_MAX_TAPS - 1));
+
+        // discrete weights of texels 0..radius, normalized over -radius..radius
+        std::vector<float> discrete(radius + 1);
+        float total = 0.0f;
+        for (int i = 0; i <= radius; i++) {
+            discrete[i] = std::exp(-(i * i) / (2.0f * sigma * sigma));
+            total += i == 0 ? discrete[i] : 2.0f * discrete[i];
+        }
+        for (float &w : discrete)
+            w /= total;
+
+        GaussianKernel kernel;
+        kernel.weights.push_back(discrete[0]);
+        kernel.offsets.push_back(0.0f);
+        // merge texels i and i + 1 into one fetch placed at their weighted center
+        for (int i = 1; i <= radius; i += 2) {
+            float w1 = discrete[i];
+            float w2 = i + 1 <= radius ? discrete[i + 1] : 0.0f;
+            float w = w1 + w2;
+            kernel.weights.push_back(w);
+            kernel.offsets.push_back((i * w1 + (i + 1) * w2) / w);
+        }
+        return kernel;
+    }
+
+    // plain kernel with one tap per texel (offsets 0, 1, 2, ...), for filters that read texels
+    // from shared memory rather than through the texture unit; radius at most maxRadius
+    static GaussianKernel Discrete(float sigma, int maxRadius)
+    {
+        sigma = std::max(sigma, 0.1f);
+        int radius = std::min((int)std::ceil(3.0f * sigma), maxRadius);
+        GaussianKernel kernel;
+        float total = 0.0f;
+        for (int i = 0; i <= radius; i++) {
+            float w = std::exp(-(i * i) / (2.0f * sigma * sigma));
+            kernel.weights.push_back(w);
+            kernel.offsets.push_back((float)i);
+            total += i == 0 ? w : 2.0f * w;
+        }
+        for (float &w : kernel.weights)
+            w /= total;
+        return kernel;
+    }
+
+    int TapCount() const
+    {
+        return weights.size();
+    }
+};
+#endif
@@ -0,0 +1,342 @@
+#ifndef HIZ_OCCLUSION_H
+#define HIZ_OCCLUSION_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/fullscreen_quad.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// Occlusion culling against the depth of earlier frames. After the opaque scene is drawn, Build reduces
+// its depth into a pyramid of ever smaller levels, each texel holding the farthest depth below it, down to
+// a level at most READBACK_WIDTH wide. That level is copied into a pixel buffer and read a few frames later,
+// once the GPU has finished it, so nothing ever waits. On the CPU the read level gets its own coarser
+// levels, and IsOccluded projects a box with the view-projection of the frame the depth came from: if the
+// box's nearest depth lies behind the farthest depth of the texels its screen rectangle covers, it can't
+// be seen. The depth is a few frames old, so an object coming out from behind a wall can show up a frame
+// or two late; boxes reaching behind the camera are always visible.
+//
+//     scene.Submit(queue, frustum, viewPos, variant, NODES_ALL, &hiz);  ...draw the opaque scene...
+//     hiz.Build(depthTexture, width, height, projection * view);
+class HiZOcclusion
+{
+public:
+    static const int READBACK_WIDTH = 160;
+    static const unsigned int READBACK_FRAMES = 3;
+
+    unsigned int pyramid = 0;
+    int width = 0, height = 0;      // of the depth the pyramid was made for
+    unsigned int tested = 0;        // boxes tested since ResetStats
+    unsigned int occluded = 0;      // of those, found hidden
+
+    HiZOcclusion() : reduceShader("resources/shaders/blur.vs", "resources/shaders/hiz_reduce.fs")
+    {
+        reduceShader.use();
+        reduceShader.setInt("source", 0);
+        uSourceSize = reduceShader.uniform("sourceSize");
+        glGenFramebuffers(1, &framebuffer);
+        for (Readback &readback : readbacks) {
+            glGenBuffers(1, &readback.buffer);
+            readback.fence = 0;
+        }
+    }
+
+    HiZOcclusion(const HiZOcclusion &) = delete;
+    HiZOcclusion &operator=(const HiZOcclusion &) = delete;
+
+    // true once a depth has been read back
+    bool Ready() const
+    {
+        return !depth.empty();
+    }
+
+    // reduces depthTexture (width x height, the scene as seen through viewProjection) and starts reading
+    // it back; also takes in the newest readback that has arrived. Leaves the default framebuffer bound
+    void Build(unsigned int depthTexture, int width, int height, const glm::mat4 &viewProjection)
+    {
+        receive();
+        if (width != this->width || height != this->height)
+            resize(width, height);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        reduceShader.use();
+        glActiveTexture(GL_TEXTURE0);
+        glm::ivec2 sourceSize(width, height);
+        for (int level = 0; level < levelCount; level++) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid, level);
+            glViewport(0, 0, levelSizes[level].x, levelSizes[level].y);
+            if (level == 0) {
+                glBindTexture(GL_TEXTURE_2D, depthTexture);
+            } else {
+                // only the level read from is visible to the shader, so there is no feedback loop
+                glBindTexture(GL_TEXTURE_2D, pyramid);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+            }
+            reduceShader.setIVec2(uSourceSize, sourceSize);
+            renderQuad();
+            sourceSize = levelSizes[level];
+        }
+        glBindTexture(GL_TEXTURE_2D, pyramid);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glEnable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+
+        // the last level is still attached
+        Readback &readback = readbacks[writeSlot];
+        if (readback.fence)
+            glDeleteSync(readback.fence);
+        readback.viewProjection = viewProjection;
+        readback.size = levelSizes[levelCount - 1];
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, readback.size.x * readback.size.y * sizeof(float), NULL, GL_STREAM_READ);
+        glReadPixels(0, 0, readback.size.x, readback.size.y, GL_RED, GL_FLOAT, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        writeSlot = (writeSlot + 1) % READBACK_FRAMES;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // whether the world space box is certainly hidden behind the read back depth
+    bool IsOccluded(const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+    {
+        if (depth.empty())
+            return false;
+        tested++;
+        // screen rectangle and nearest depth of the eight corners, in NDC
+        float rect[4];  // min x, min y, max x, max y
+        float nearest;
+        if (!project(boxMin, boxMax, rect, nearest))
+            return false;
+        rect[0] = std::max(rect[0], -1.0f);
+        rect[1] = std::max(rect[1], -1.0f);
+        rect[2] = std::min(rect[2], 1.0f);
+        rect[3] = std::min(rect[3], 1.0f);
+        if (rect[0] > rect[2] || rect[1] > rect[3])
+            return false;   // off screen, the frustum culling's business
+        nearest = nearest * 0.5f + 0.5f;
+
+        // texels of the finest CPU level, then the level where the rectangle spans at most 2x2 texels
+        const glm::ivec2 &size = cpuSizes[0];
+        int x0 = std::min((int) ((rect[0] * 0.5f + 0.5f) * size.x), size.x - 1);
+        int y0 = std::min((int) ((rect[1] * 0.5f + 0.5f) * size.y), size.y - 1);
+        int x1 = std::min((int) ((rect[2] * 0.5f + 0.5f) * size.x), size.x - 1);
+        int y1 = std::min((int) ((rect[3] * 0.5f + 0.5f) * size.y), size.y - 1);
+        unsigned int level = 0;
+        while (level + 1 < cpuSizes.size() && std::max(x1 - x0, y1 - y0) > 1) {
+            x0 >>= 1; y0 >>= 1; x1 >>= 1; y1 >>= 1;
+            level++;
+        }
+        const float *texels = depth.data() + cpuOffsets[level];
+        int rowLength = cpuSizes[level].x;
+        float farthest = 0.0f;
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++)
+                farthest = std::max(farthest, texels[y * rowLength + x]);
+        if (nearest > farthest) {
+            occluded++;
+            return true;
+        }
+        return false;
+    }
+
+    // forgets the read back depth, e.g. when Build hasn't been called for a while and it went stale
+    void Invalidate()
+    {
+        depth.clear();
+    }
+
+    void ResetStats()
+    {
+        tested = occluded = 0;
+    }
+
+    // call it while the GL context is still alive
+    void Clear()
+    {
+        for (Readback &readback : readbacks) {
+            if (readback.fence)
+                glDeleteSync(readback.fence);
+            glDeleteBuffers(1, &readback.buffer);
+            readback.fence = 0;
+            readback.buffer = 0;
+        }
+        glDeleteTextures(1, &pyramid);
+        glDeleteFramebuffers(1, &framebuffer);
+        pyramid = framebuffer = 0;
+    }
+
+private:
+    struct Readback {
+        unsigned int buffer;
+        GLsync fence;   // 0 when nothing is pending
+        glm::mat4 viewProjection;
+        glm::ivec2 size;
+    };
+
+    Shader reduceShader;
+    UniformHandle uSourceSize;
+    unsigned int framebuffer = 0;
+    int levelCount = 0;
+    std::vector<glm::ivec2> levelSizes;
+    Readback readbacks[READBACK_FRAMES];
+    unsigned int writeSlot = 0;
+
+    // the read back level and its CPU made coarser levels, one after the other
+    std::vector<float> depth;
+    std::vector<glm::ivec2> cpuSizes;
+    std::vector<unsigned int> cpuOffsets;
+    glm::mat4 depthViewProjection;
+
+    // pyramid levels halve down to the first one at most READBACK_WIDTH wide
+    void resize(int width, int height)
+    {
+        this->width = width;
+        this->height = height;
+        levelSizes.clear();
+        glm::ivec2 size(width, height);
+        do {
+            size = glm::ivec2(std::max(size.x / 2, 1), std::max(size.y / 2, 1));
+            levelSizes.push_back(size);
+        } while (size.x > READBACK_WIDTH && size.x > 1);
+        levelCount = levelSizes.size();
+
+        glDeleteTextures(1, &pyramid);
+        glGenTextures(1, &pyramid);
+        glBindTexture(GL_TEXTURE_2D, pyramid);
+        for (int level = 0; level < levelCount; level++)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, levelSizes[level].x, levelSizes[level].y, 0, GL_RED, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::HIZ:: pyramid framebuffer not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // takes the newest finished readback, oldest pending first so a newer one overrides it. The texels map
+    // onto the screen in proportion, so a readback made at an older size still works
+    void receive()
+    {
+        for (unsigned int i = 0; i < READBACK_FRAMES; i++) {
+            Readback &readback = readbacks[(writeSlot + i) % READBACK_FRAMES];
+            if (!readback.fence)
+                continue;
+            GLenum status = glClientWaitSync(readback.fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                continue;
+            glDeleteSync(readback.fence);
+            readback.fence = 0;
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+            unsigned int count = readback.size.x * readback.size.y;
+            const float *texels = (const float *) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * sizeof(float), GL_MAP_READ_BIT);
+            if (texels) {
+                buildCpuLevels(texels, readback.size);
+                depthViewProjection = readback.viewProjection;
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+    }
+
+    // the read back level, then halvings (rounded up, a texel covers 2x2 below it) down to 1x1
+    void buildCpuLevels(const float *texels, glm::ivec2 size)
+    {
+        cpuSizes.assign(1, size);
+        cpuOffsets.assign(1, 0);
+        depth.assign(texels, texels + size.x * size.y);
+        while (size.x > 1 || size.y > 1) {
+            glm::ivec2 next((size.x + 1) / 2, (size.y + 1) / 2);
+            unsigned int source = cpuOffsets.back();
+            unsigned int offset = depth.size();
+            depth.resize(offset + next.x * next.y);
+            for (int y = 0; y < next.y; y++)
+                for (int x = 0; x < next.x; x++) {
+                    int sx = std::min(2 * x + 1, size.x - 1), sy = std::min(2 * y + 1, size.y - 1);
+                    const float *row0 = &depth[source + 2 * y * size.x];
+                    const float *row1 = &depth[source + sy * size.x];
+                    depth[offset + y * next.x + x] = std::max(std::max(row0[2 * x], row0[sx]), std::max(row1[2 * x], row1[sx]));
+                }
+            cpuSizes.push_back(next);
+            cpuOffsets.push_back(offset);
+            size = next;
+        }
+    }
+
+    // NDC bounds of the box's corners; false if a corner lies behind the camera. The eight corners are
+    // projected four at a time with SSE where available
+    bool project(const glm::vec3 &boxMin, const glm::vec3 &boxMax, float rect[4], float &nearest) const
+    {
+        const glm::mat4 &m = depthViewProjection;
+#if defined(__SSE__) || defined(_M_X64)
+        __m128 xs = _mm_setr_ps(boxMin.x, boxMax.x, boxMin.x, boxMax.x);
+        __m128 ys = _mm_setr_ps(boxMin.y, boxMin.y, boxMax.y, boxMax.y);
+        __m128 lo = _mm_set1_ps(1.0e30f), hi = _mm_set1_ps(-1.0e30f);
+        __m128 loX = lo, loY = lo, loZ = lo, hiX = hi, hiY = hi;
+        __m128 epsilon = _mm_set1_ps(1.0e-5f);
+        for (float z : {boxMin.z, boxMax.z}) {
+            __m128 zs = _mm_set1_ps(z);
+            __m128 clip[4];
+            for (int row = 0; row < 4; row++)
+                clip[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][row]), xs), _mm_mul_ps(_mm_set1_ps(m[1][row]), ys)),
+                                       _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2][row]), zs), _mm_set1_ps(m[3][row])));
+            if (_mm_movemask_ps(_mm_cmple_ps(clip[3], epsilon)) != 0)
+                return false;
+            __m128 inverseW = _mm_div_ps(_mm_set1_ps(1.0f), clip[3]);
+            __m128 x = _mm_mul_ps(clip[0], inverseW), y = _mm_mul_ps(clip[1], inverseW), zNdc = _mm_mul_ps(clip[2], inverseW);
+            loX = _mm_min_ps(loX, x);
+            hiX = _mm_max_ps(hiX, x);
+            loY = _mm_min_ps(loY, y);
+            hiY = _mm_max_ps(hiY, y);
+            loZ = _mm_min_ps(loZ, zNdc);
+        }
+        float values[5][4];
+        _mm_storeu_ps(values[0], loX);
+        _mm_storeu_ps(values[1], loY);
+        _mm_storeu_ps(values[2], hiX);
+        _mm_storeu_ps(values[3], hiY);
+        _mm_storeu_ps(values[4], loZ);
+        for (int i = 0; i < 4; i++)
+            rect[i] = i < 2 ? std::min(std::min(values[i][0], values[i][1]), std::min(values[i][2], values[i][3]))
+                            : std::max(std::max(values[i][0], values[i][1]), std::max(values[i][2], values[i][3]));
+        nearest = std::min(std::min(values[4][0], values[4][1]), std::min(values[4][2], values[4][3]));
+#else
+        rect[0] = rect[1] = nearest = 1.0e30f;
+        rect[2] = rect[3] = -1.0e30f;
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec4 clip = m * glm::vec4(corner & 1 ? boxMax.x : boxMin.x, corner & 2 ? boxMax.y : boxMin.y,
+                                           corner & 4 ? boxMax.z : boxMin.z, 1.0f);
+            if (clip.w <= 1.0e-5f)
+                return false;
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            rect[0] = std::min(rect[0], ndc.x);
+            rect[1] = std::min(rect[1], ndc.y);
+            rect[2] = std::max(rect[2], ndc.x);
+            rect[3] = std::max(rect[3], ndc.y);
+            nearest = std::min(nearest, ndc.z);
+        }
+#endif
+        return true;
+    }
+};
+#endif
@@ -0,0 +1,39 @@
+#ifndef LIGHT_SOURCE_H
+#define LIGHT_SOURCE_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// A point light as both lighting paths read it: four vec4 texels of the clustered light buffer
+// (2.model_lighting.fs) or four per-instance attributes of the deferred light volumes (deferred_point.vs).
+// Light falls off as 1 / (constant + linear * d + quadratic * d^2), windowed to reach zero at radius,
+// so no light has to be evaluated beyond its radius.
+struct PointLightSource {
+    glm::vec3 position;
+    float radius;
+    glm::vec3 ambient;
+    float constant;
+    glm::vec3 diffuse;
+    float linear;
+    glm::vec3 specular;
+    float quadratic;
+};
+
+static_assert(sizeof(PointLightSource) == 64, "PointLightSource must be four vec4s");
+
+// distance where light's attenuation has dimmed its brightest component below cutoff
+inline float PointLightRadius(const PointLightSource &light, float cutoff = 0.02f)
+{
+    glm::vec3 color = light.ambient + light.diffuse + light.specular;
+    float brightest = std::max(color.r, std::max(color.g, color.b));
+    // solve constant + linear * d + quadratic * d^2 = brightest / cutoff
+    float c = light.constant - brightest / cutoff;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (light.quadratic <= 0.0f)
+        return light.linear > 0.0f ? -c / light.linear : 1.0e4f;
+    return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+}
+#endif
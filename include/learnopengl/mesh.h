@@ -6,8 +6,11 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <learnopengl/shader.h>
+#include <learnopengl/shader_m.h>
 
+#include <algorithm>
+#include <array>
+#include <map>
 #include <string>
 #include <vector>
 using namespace std;
@@ -27,79 +30,226 @@ struct Vertex {
 
 
 
+// bounding volumes of a mesh in model space, used for culling
+struct Bounds {
+    glm::vec3 aabbMin;
+    glm::vec3 aabbMax;
+    glm::vec3 center;   // bounding sphere
+    float radius;
+};
+
+// one level of detail: a range of the mesh's index buffer drawing a simplified version of the same vertices
+const unsigned int MAX_MESH_LODS = 4;
+struct MeshLod {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    float error;    // largest distance of a vertex from the full detail triangle planes it replaces, in model space; 0 for the full mesh
+};
+
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
+// every material samples its textures from the same, fixed texture units, so the sampler uniforms
+// are set once per shader (SetMaterialSamplers) instead of before every draw
+enum TextureSlot {
+    SLOT_DIFFUSE  = 0,  // material.texture_diffuse1
+    SLOT_SPECULAR = 1,  // material.texture_specular1
+    SLOT_NORMAL   = 2,  // material.texture_normal1
+    SLOT_HEIGHT   = 3,  // material.texture_height1
+    SLOT_COUNT
+};
+
+// points the sampler uniforms of shader at the fixed texture slots
+inline void SetMaterialSamplers(Shader &shader, const std::string &prefix = "material.")
+{
+    shader.use();
+    shader.setInt(prefix + "texture_diffuse1", SLOT_DIFFUSE);
+    shader.setInt(prefix + "texture_specular1", SLOT_SPECULAR);
+    shader.setInt(prefix + "texture_normal1", SLOT_NORMAL);
+    shader.setInt(prefix + "texture_height1", SLOT_HEIGHT);
+}
+
+// small integer naming a distinct combination of slot textures; meshes that sample the same
+// textures share an id, which lets the RenderQueue group their draws
+inline unsigned int MaterialId(const unsigned int (&slots)[SLOT_COUNT])
+{
+    static std::map<std::array<unsigned int, SLOT_COUNT>, unsigned int> ids;
+    std::array<unsigned int, SLOT_COUNT> key;
+    std::copy(slots, slots + SLOT_COUNT, key.begin());
+    auto it = ids.find(key);
+    if (it != ids.end())
+        return it->second;
+    unsigned int id = ids.size();
+    ids[key] = id;
+    return id;
+}
+
 class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
-    vector<unsigned int> indices;
+    vector<unsigned int> indices;   // of every LOD, one after the other
     vector<Texture>      textures;
+    vector<MeshLod>      lods;      // lods[0] is the full mesh, each further one coarser
+
+    Bounds bounds;
 
     unsigned int VAO;
-    std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    unsigned int depthVAO;  // positions and instance matrices only, for depth-only passes
+    unsigned int indexCount;    // of the full detail LOD
+    unsigned int slotTextures[SLOT_COUNT];  // texture bound to each TextureSlot, 0 if the material has none
+    unsigned int materialId;
+    // constructor. Without lods all indices make up a single, full detail LOD
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, vector<MeshLod> lods = vector<MeshLod>())
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+        setupLods(lods);
+        setupMaterial();
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // uploads vertex and index data straight from memory the mesh doesn't own (e.g. a mapped mesh cache),
+    // without keeping a CPU copy; vertices and indices stay empty
+    Mesh(const Vertex *vertices, unsigned int vertexCount, const unsigned int *indices, unsigned int indexCount, vector<Texture> textures,
+         vector<MeshLod> lods = vector<MeshLod>())
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
-
+        this->textures = textures;
+        setupMesh(vertices, vertexCount, indices, indexCount);
+        setupLods(lods);
+        setupMaterial();
+    }
 
+    // render the mesh. The shader's samplers must have been set up with SetMaterialSamplers
+    void Draw(Shader &shader)
+    {
+        BindTextures();
 
         // draw mesh
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // render count copies of the mesh in one draw call. The model matrices are streamed into a
+    // per-instance vertex buffer read by the shader at attribute locations 5-8 (layout (location = 5) in mat4)
+    void DrawInstanced(Shader &shader, const glm::mat4 *models, unsigned int count)
+    {
+        if (count == 0)
+            return;
+        UploadInstances(models, count);
+        BindTextures();
+
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, count);
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // replaces the per-instance model matrices
+    void UploadInstances(const glm::mat4 *models, unsigned int count) const
+    {
+        // orphan the previous contents so the driver doesn't have to wait for the last draw to finish
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), models, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // deletes the mesh's vertex arrays and buffers. Copies of a Mesh share them, so only one copy may call it
+    void Clear()
+    {
+        unsigned int vaos[2] = {VAO, depthVAO};
+        unsigned int buffers[4] = {VBO, EBO, positionVBO, instanceVBO};
+        glDeleteVertexArrays(2, vaos);
+        glDeleteBuffers(4, buffers);
+        VAO = depthVAO = VBO = EBO = positionVBO = instanceVBO = 0;
+    }
+
+    // binds every slot texture to its unit
+    void BindTextures() const
+    {
+        for (unsigned int slot = 0; slot < SLOT_COUNT; slot++)
+        {
+            glActiveTexture(GL_TEXTURE0 + slot);
+            glBindTexture(GL_TEXTURE_2D, slotTextures[slot]);
+        }
+    }
+
 private:
     // render data
     unsigned int VBO, EBO;
+    unsigned int positionVBO;
+    unsigned int instanceVBO = 0;
+
+    // indexCount is still the size of the whole index buffer here
+    void setupLods(const vector<MeshLod> &lods)
+    {
+        this->lods = lods;
+        if (this->lods.empty())
+            this->lods.push_back(MeshLod{0, indexCount, 0.0f});
+        indexCount = this->lods[0].indexCount;
+    }
+
+    // assigns the first texture of each type to its slot
+    void setupMaterial()
+    {
+        for (unsigned int &texture : slotTextures)
+            texture = 0;
+        for (const Texture &texture : textures)
+        {
+            int slot = -1;
+            if (texture.type == "texture_diffuse")
+                slot = SLOT_DIFFUSE;
+            else if (texture.type == "texture_specular")
+                slot = SLOT_SPECULAR;
+            else if (texture.type == "texture_normal")
+                slot = SLOT_NORMAL;
+            else if (texture.type == "texture_height")
+                slot = SLOT_HEIGHT;
+            if (slot != -1 && slotTextures[slot] == 0)
+                slotTextures[slot] = texture.id;
+        }
+        // materials without a specular map have always been lit with their diffuse texture
+        if (slotTextures[SLOT_SPECULAR] == 0)
+            slotTextures[SLOT_SPECULAR] = slotTextures[SLOT_DIFFUSE];
+        materialId = MaterialId(slotTextures);
+    }
+
+    // adds the per-instance model matrix to the (still bound) VAO; a mat4 attribute takes four consecutive locations.
+    // It starts out as a single identity matrix, so the instanced shader can draw the mesh untransformed.
+    // Both VAOs of the mesh read the same instance buffer
+    void setupInstancing()
+    {
+        if (instanceVBO == 0) {
+            const glm::mat4 identity(1.0f);
+            glGenBuffers(1, &instanceVBO);
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4), &identity, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            glEnableVertexAttribArray(5 + i);
+            glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + i, 1);
+        }
+    }
 
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const Vertex *vertices, unsigned int vertexCount, const unsigned int *indices, unsigned int indexCount)
     {
+        this->indexCount = indexCount;
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -111,10 +261,10 @@ private:
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices, GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
         // vertex Positions
@@ -132,8 +282,26 @@ private:
         // vertex bitangent
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        // per-instance model matrix
+        setupInstancing();
+
+        // the depth pre-pass reads only positions; packed on their own they are 12 bytes per vertex instead of
+        // sizeof(Vertex), so it fetches a fraction of the vertex data
+        vector<glm::vec3> positions(vertexCount);
+        for (unsigned int i = 0; i < vertexCount; i++)
+            positions[i] = vertices[i].Position;
+        glGenVertexArrays(1, &depthVAO);
+        glGenBuffers(1, &positionVBO);
+        glBindVertexArray(depthVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        setupInstancing();
 
         glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 };
 #endif
\ No newline at end of file
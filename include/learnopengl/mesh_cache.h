@@ -0,0 +1,166 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+// Binary cache of an imported model, written next to the source file as <model file>.meshcache.
+// Layout (native endianness, every section 4 byte aligned):
+//     MeshCacheHeader
+//     per mesh: MeshCacheEntry, textureCount * (uint32 type length, type, uint32 path length, path, padding),
+//               vertexCount * Vertex, indexCount * uint32 (every LOD), lodCount * MeshLod
+// The cache is valid only if the version, the Vertex size and the hash of the source files all match.
+const uint32_t MESH_CACHE_VERSION = 3;
+const char MESH_CACHE_MAGIC[4] = {'P', 'B', 'M', 'C'};
+
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint32_t vertexSize;
+    uint32_t meshCount;
+};
+
+struct MeshCacheEntry {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    uint32_t lodCount;
+    Bounds bounds;
+};
+
+// read-only memory mapping of a whole file, unmapped when it goes out of scope
+class MappedFile
+{
+public:
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+
+    explicit MappedFile(const std::string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+            return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data = static_cast<const unsigned char *>(mapped);
+                size = st.st_size;
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (data)
+            munmap(const_cast<unsigned char *>(data), size);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+};
+
+// 64-bit FNV-1a
+inline uint64_t HashBytes(const unsigned char *data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// hash of the file's contents, 0 if it can't be read
+inline uint64_t HashFile(const std::string &path)
+{
+    MappedFile file(path);
+    return file.data ? HashBytes(file.data, file.size) : 0;
+}
+
+// hash of a model file and, for an OBJ, of the material libraries it names (mtllib lines, relative to
+// directory), so editing a .mtl invalidates the cache too. 0 if the model file can't be read
+inline uint64_t HashModelFiles(const std::string &path, const std::string &directory)
+{
+    MappedFile file(path);
+    if (!file.data)
+        return 0;
+    uint64_t hash = HashBytes(file.data, file.size);
+    const char *text = reinterpret_cast<const char *>(file.data);
+    for (size_t line = 0; line < file.size; ) {
+        size_t end = line;
+        while (end < file.size && text[end] != '\n')
+            end++;
+        if (end - line > 7 && std::strncmp(text + line, "mtllib ", 7) == 0) {
+            std::string library(text + line + 7, end - line - 7);
+            library.erase(library.find_last_not_of(" \t\r") + 1);
+            // a library that doesn't exist yet hashes as 0, creating it changes the hash as well
+            hash = (hash ^ HashFile(directory + '/' + library)) * 1099511628211ull;
+        }
+        line = end + 1;
+    }
+    return hash;
+}
+
+// bounds checked reader over a mapped cache file
+class MeshCacheReader
+{
+public:
+    MeshCacheReader(const unsigned char *data, size_t size) : data(data), size(size) {}
+
+    // returns a pointer to the next count * sizeof(T) bytes and moves past them (and the padding), or nullptr
+    template <typename T>
+    const T *read(size_t count = 1)
+    {
+        size_t bytes = count * sizeof(T);
+        if (offset + bytes > size)
+            return nullptr;
+        const T *result = reinterpret_cast<const T *>(data + offset);
+        offset = (offset + bytes + 3) & ~size_t(3);
+        return result;
+    }
+
+    bool readString(std::string &out)
+    {
+        const uint32_t *length = read<uint32_t>();
+        if (!length)
+            return false;
+        const char *chars = read<char>(*length);
+        if (!chars)
+            return false;
+        out.assign(chars, *length);
+        return true;
+    }
+
+private:
+    const unsigned char *data;
+    size_t size;
+    size_t offset = 0;
+};
+
+// writes data padded to 4 bytes
+inline void WriteCacheBytes(std::ofstream &out, const void *data, size_t bytes)
+{
+    static const char padding[4] = {0, 0, 0, 0};
+    out.write(static_cast<const char *>(data), bytes);
+    out.write(padding, (4 - bytes % 4) % 4);
+}
+
+inline void WriteCacheString(std::ofstream &out, const std::string &s)
+{
+    uint32_t length = s.size();
+    WriteCacheBytes(out, &length, sizeof(length));
+    WriteCacheBytes(out, s.data(), s.size());
+}
+#endif
@@ -0,0 +1,220 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+// Quadric error metric of a vertex (Garland & Heckbert): the area weighted sum of the squared distances to
+// the planes of its triangles, as the symmetric 4x4 matrix [A b; b c]. Doubles, as positions far from the
+// origin lose the small distances otherwise
+struct Quadric {
+    double a00, a11, a22, a10, a20, a21;
+    double b0, b1, b2;
+    double c;
+    double weight;  // total area, so the error is a mean squared distance
+};
+
+inline void AddQuadric(Quadric &q, const Quadric &other)
+{
+    q.a00 += other.a00; q.a11 += other.a11; q.a22 += other.a22;
+    q.a10 += other.a10; q.a20 += other.a20; q.a21 += other.a21;
+    q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+    q.c += other.c;
+    q.weight += other.weight;
+}
+
+// the quadric of the plane dot(normal, p) + d = 0, weighted by area
+inline Quadric PlaneQuadric(const glm::vec3 &normal, float d, float area)
+{
+    double x = normal.x, y = normal.y, z = normal.z, w = d;
+    return Quadric{area * x * x, area * y * y, area * z * z, area * y * x, area * z * x, area * z * y,
+                   area * x * w, area * y * w, area * z * w, area * w * w, area};
+}
+
+// mean squared distance of p from the planes of q; ranks collapses, it is no bound on how far a vertex moved
+inline float QuadricError(const Quadric &q, const glm::vec3 &p)
+{
+    double x = p.x, y = p.y, z = p.z;
+    double ax = q.a00 * x + q.a10 * y + q.a20 * z;
+    double ay = q.a10 * x + q.a11 * y + q.a21 * z;
+    double az = q.a20 * x + q.a21 * y + q.a22 * z;
+    double e = x * ax + y * ay + z * az + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+    return q.weight > 0.0 ? float(std::fabs(e) / q.weight) : 0.0f;
+}
+
+// Simplifies the triangle list indices to about targetIndexCount indices by collapsing edges, one vertex onto
+// the other, cheapest quadric error first. No vertex is created or moved, so the result indexes the same
+// vertices and can share their buffer. Vertices on open edges never move, which keeps silhouettes, holes and
+// UV or normal seams (where vertices are split, so their edges are open) where they are. error receives the
+// largest distance of a surviving vertex from the plane of any original triangle it now stands in for, in
+// the units of the positions: a bound on the deviation at the vertices, not an average
+inline std::vector<unsigned int> SimplifyMesh(const Vertex *vertices, unsigned int vertexCount,
+                                              const std::vector<unsigned int> &indices, unsigned int targetIndexCount, float &error)
+{
+    std::vector<unsigned int> result(indices);
+    error = 0.0f;
+
+    // an edge is open if no triangle runs along it the other way
+    std::unordered_set<uint64_t> edges;
+    for (unsigned int i = 0; i < result.size(); i += 3)
+        for (unsigned int e = 0; e < 3; e++)
+            edges.insert(uint64_t(result[i + e]) << 32 | result[i + (e + 1) % 3]);
+    std::vector<unsigned char> locked(vertexCount, 0);
+    for (unsigned int i = 0; i < result.size(); i += 3)
+        for (unsigned int e = 0; e < 3; e++) {
+            unsigned int a = result[i + e], b = result[i + (e + 1) % 3];
+            if (!edges.count(uint64_t(b) << 32 | a))
+                locked[a] = locked[b] = 1;
+        }
+
+    // besides the quadrics, every vertex keeps the original triangle planes it stands in for, the error is
+    // measured against those
+    std::vector<Quadric> quadrics(vertexCount, Quadric{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
+    std::vector<glm::vec4> planes;
+    std::vector<std::vector<unsigned int>> planesOf(vertexCount);
+    for (unsigned int i = 0; i < result.size(); i += 3) {
+        const glm::vec3 &p0 = vertices[result[i]].Position;
+        glm::vec3 normal = glm::cross(vertices[result[i + 1]].Position - p0, vertices[result[i + 2]].Position - p0);
+        float length = glm::length(normal);
+        if (length == 0.0f)
+            continue;
+        normal /= length;
+        float d = -glm::dot(normal, p0);
+        Quadric plane = PlaneQuadric(normal, d, length * 0.5f);
+        for (unsigned int k = 0; k < 3; k++) {
+            AddQuadric(quadrics[result[i + k]], plane);
+            planesOf[result[i + k]].push_back(planes.size());
+        }
+        planes.push_back(glm::vec4(normal, d));
+    }
+
+    struct Collapse {
+        unsigned int from, to;
+        float cost;
+    };
+    std::vector<Collapse> collapses;
+    std::vector<unsigned int> target(vertexCount);
+    std::vector<unsigned char> touched(vertexCount);
+    std::vector<unsigned int> firstTriangle, triangles;     // triangles around each vertex
+
+    // every pass collapses edges from the cheaper half, each vertex at most once, then rebuilds the index list
+    while (result.size() > targetIndexCount) {
+        firstTriangle.assign(vertexCount + 1, 0);
+        for (unsigned int index : result)
+            firstTriangle[index + 1]++;
+        for (unsigned int v = 0; v < vertexCount; v++)
+            firstTriangle[v + 1] += firstTriangle[v];
+        triangles.resize(result.size());
+        std::vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (unsigned int i = 0; i < result.size(); i++)
+            triangles[fill[result[i]]++] = i / 3;
+
+        collapses.clear();
+        for (unsigned int i = 0; i < result.size(); i += 3)
+            for (unsigned int e = 0; e < 3; e++) {
+                unsigned int a = result[i + e], b = result[i + (e + 1) % 3];
+                for (unsigned int k = 0; k < 2; k++, std::swap(a, b)) {
+                    if (locked[a])
+                        continue;
+                    Quadric q = quadrics[a];
+                    AddQuadric(q, quadrics[b]);
+                    collapses.push_back(Collapse{a, b, QuadricError(q, vertices[b].Position)});
+                }
+            }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+        collapses.resize(collapses.size() / 2 + 1);
+
+        for (unsigned int v = 0; v < vertexCount; v++)
+            target[v] = v;
+        std::fill(touched.begin(), touched.end(), 0);
+        unsigned int triangleCount = result.size() / 3, goal = targetIndexCount / 3;
+        unsigned int applied = 0;
+        for (const Collapse &collapse : collapses) {
+            if (triangleCount <= goal)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+            // the triangles that keep existing must not turn over
+            const glm::vec3 &to = vertices[collapse.to].Position;
+            bool flips = false;
+            unsigned int removed = 0;
+            for (unsigned int t = firstTriangle[collapse.from]; t < firstTriangle[collapse.from + 1] && !flips; t++) {
+                const unsigned int *tri = &result[triangles[t] * 3];
+                if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) {
+                    removed++;
+                    continue;
+                }
+                glm::vec3 p[3], q[3];
+                for (unsigned int k = 0; k < 3; k++) {
+                    p[k] = vertices[tri[k]].Position;
+                    q[k] = tri[k] == collapse.from ? to : p[k];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                flips = glm::dot(before, after) <= 0.0f && glm::dot(before, before) > 0.0f;
+            }
+            if (flips)
+                continue;
+            target[collapse.from] = collapse.to;
+            touched[collapse.from] = touched[collapse.to] = 1;
+            AddQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+            std::vector<unsigned int> &merged = planesOf[collapse.to];
+            merged.insert(merged.end(), planesOf[collapse.from].begin(), planesOf[collapse.from].end());
+            std::vector<unsigned int>().swap(planesOf[collapse.from]);
+            // planes of the vertex's own earlier collapses are included, they may now be farther away
+            for (unsigned int plane : merged)
+                error = std::max(error, std::fabs(glm::dot(glm::vec3(planes[plane]), to) + planes[plane].w));
+            triangleCount -= std::min(removed, triangleCount);
+            applied++;
+        }
+        if (applied == 0)
+            break;
+
+        unsigned int kept = 0;
+        for (unsigned int i = 0; i < result.size(); i += 3) {
+            unsigned int a = target[result[i]], b = target[result[i + 1]], c = target[result[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[kept++] = a;
+            result[kept++] = b;
+            result[kept++] = c;
+        }
+        // passes that hardly remove anything (flips everywhere) aren't worth going on with
+        bool stalled = kept * 100 > result.size() * 99;
+        result.resize(kept);
+        if (stalled)
+            break;
+    }
+    return result;
+}
+
+// Appends up to MAX_MESH_LODS - 1 simplified versions of the full detail triangle list in indices to it, each
+// with about half the triangles of the one before, and describes all of them in lods. Stops early once the
+// mesh won't get noticeably simpler, e.g. because most of it lies on seams
+inline void BuildMeshLods(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, std::vector<MeshLod> &lods)
+{
+    const unsigned int MIN_LOD_INDICES = 3 * 64;  // meshes this small aren't worth simplifying
+    std::vector<unsigned int> full(indices);
+    lods.assign(1, MeshLod{0, (unsigned int) full.size(), 0.0f});
+    unsigned int target = full.size();
+    while (lods.size() < MAX_MESH_LODS && lods.back().indexCount >= MIN_LOD_INDICES) {
+        target = target / 6 * 3;
+        float error;
+        // every LOD is made from the full mesh, so its error is measured against the full mesh as well
+        std::vector<unsigned int> simplified = SimplifyMesh(vertices.data(), vertices.size(), full, target, error);
+        if (simplified.empty() || simplified.size() > lods.back().indexCount * 3 / 4)
+            break;
+        lods.push_back(MeshLod{(unsigned int) indices.size(), (unsigned int) simplified.size(), std::max(error, lods.back().error)});
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+    }
+}
+#endif
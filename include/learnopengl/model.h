@@ -11,13 +11,17 @@
 #include <assimp/postprocess.h>
 
 #include <learnopengl/mesh.h>
-#include <learnopengl/shader.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_simplify.h>
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/shader_m.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <algorithm>
 #include <vector>
 using namespace std;
 
@@ -29,7 +33,7 @@ class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// every texture this model acquired from the TextureCache, released again by the destructor
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
@@ -40,6 +44,17 @@ public:
         loadModel(path);
     }
 
+    // gives the textures back to the TextureCache; needs a current GL context
+    ~Model()
+    {
+        for (const Texture &texture : textures_loaded)
+            TextureCache::Instance().Release(texture.id);
+    }
+
+    // copies would release the same textures twice
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
@@ -47,29 +62,146 @@ public:
             meshes[i].Draw(shader);
     }
 
-    void SetShaderTextureNamePrefix(std::string prefix) {
-        for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
-        }
+    // draws one copy of the model per matrix in models, with a single draw call per mesh.
+    // the shader has to read the model matrix from the instance attribute, see 2.model_lighting_instanced.vs
+    void DrawInstanced(Shader &shader, const vector<glm::mat4> &models)
+    {
+        if (models.empty())
+            return;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, models.data(), models.size());
     }
+
 private:
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        // a cache written by an earlier run skips Assimp and the LOD generation entirely, as long as the source files haven't changed
+        string cachePath = path + ".meshcache";
+        uint64_t sourceHash = HashModelFiles(path, directory);
+        if (sourceHash != 0 && loadCache(cachePath, sourceHash))
+            return;
+
         // read file via ASSIMP
+        // identical vertices are joined, otherwise every triangle would be on its own and the LOD simplification couldn't collapse anything
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
-
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+
+        if (sourceHash != 0)
+            writeCache(cachePath, sourceHash);
+    }
+
+    // builds the meshes from a mapped cache file. Vertex and index data are uploaded directly from the mapping.
+    bool loadCache(const string &cachePath, uint64_t sourceHash)
+    {
+        MappedFile file(cachePath);
+        if (!file.data)
+            return false;
+        MeshCacheReader reader(file.data, file.size);
+        const MeshCacheHeader *header = reader.read<MeshCacheHeader>();
+        if (!header || std::memcmp(header->magic, MESH_CACHE_MAGIC, 4) != 0 || header->version != MESH_CACHE_VERSION
+            || header->vertexSize != sizeof(Vertex) || header->sourceHash != sourceHash)
+            return false;
+
+        // a truncated or corrupt cache gives back whatever was built from it so far, then Assimp starts over
+        vector<Mesh> cached;
+        size_t firstTexture = textures_loaded.size();
+        if (!readCachedMeshes(reader, header->meshCount, cached))
+        {
+            for (Mesh &mesh : cached)
+                mesh.Clear();
+            for (size_t i = firstTexture; i < textures_loaded.size(); i++)
+                TextureCache::Instance().Release(textures_loaded[i].id);
+            textures_loaded.resize(firstTexture);
+            return false;
+        }
+        meshes.insert(meshes.end(), cached.begin(), cached.end());
+        return true;
+    }
+
+    // appends the cache's meshes to cached; false as soon as one of them can't be read
+    bool readCachedMeshes(MeshCacheReader &reader, uint32_t meshCount, vector<Mesh> &cached)
+    {
+        for (uint32_t m = 0; m < meshCount; m++)
+        {
+            const MeshCacheEntry *entry = reader.read<MeshCacheEntry>();
+            if (!entry)
+                return false;
+            vector<Texture> textures;
+            for (uint32_t t = 0; t < entry->textureCount; t++)
+            {
+                string type, texturePath;
+                if (!reader.readString(type) || !reader.readString(texturePath))
+                    return false;
+                textures.push_back(loadTexture(texturePath, type));
+            }
+            const Vertex *vertices = reader.read<Vertex>(entry->vertexCount);
+            const unsigned int *indices = reader.read<unsigned int>(entry->indexCount);
+            const MeshLod *lods = reader.read<MeshLod>(entry->lodCount);
+            if (!vertices || !indices || !lods || !validLods(lods, entry->lodCount, entry->indexCount))
+                return false;
+            cached.push_back(Mesh(vertices, entry->vertexCount, indices, entry->indexCount, textures,
+                                  vector<MeshLod>(lods, lods + entry->lodCount)));
+            cached.back().bounds = entry->bounds;
+        }
+        return true;
+    }
+
+    // at least one and at most MAX_MESH_LODS LODs, each a whole number of triangles inside the index buffer
+    static bool validLods(const MeshLod *lods, uint32_t lodCount, uint32_t indexCount)
+    {
+        if (lodCount == 0 || lodCount > MAX_MESH_LODS)
+            return false;
+        for (uint32_t i = 0; i < lodCount; i++)
+            if (lods[i].firstIndex > indexCount || lods[i].indexCount > indexCount - lods[i].firstIndex || lods[i].indexCount % 3 != 0)
+                return false;
+        return true;
+    }
+
+    void writeCache(const string &cachePath, uint64_t sourceHash) const
+    {
+        std::ofstream out(cachePath, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            cout << "WARNING::MODEL:: can't write mesh cache " << cachePath << endl;
+            return;
+        }
+        MeshCacheHeader header;
+        std::memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+        header.version = MESH_CACHE_VERSION;
+        header.sourceHash = sourceHash;
+        header.vertexSize = sizeof(Vertex);
+        header.meshCount = meshes.size();
+        WriteCacheBytes(out, &header, sizeof(header));
+        for (const Mesh &mesh : meshes)
+        {
+            MeshCacheEntry entry;
+            entry.vertexCount = mesh.vertices.size();
+            entry.indexCount = mesh.indices.size();
+            entry.textureCount = mesh.textures.size();
+            entry.lodCount = mesh.lods.size();
+            entry.bounds = mesh.bounds;
+            WriteCacheBytes(out, &entry, sizeof(entry));
+            for (const Texture &texture : mesh.textures)
+            {
+                WriteCacheString(out, texture.type);
+                WriteCacheString(out, texture.path);
+            }
+            WriteCacheBytes(out, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            WriteCacheBytes(out, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+            WriteCacheBytes(out, mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+        }
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -143,6 +275,24 @@ private:
 
 
         }
+        // bounding box and a sphere around its center; the sphere is what the frustum culling tests
+        Bounds bounds;
+        bounds.aabbMin = glm::vec3(0.0f);
+        bounds.aabbMax = glm::vec3(0.0f);
+        if (!vertices.empty())
+        {
+            bounds.aabbMin = bounds.aabbMax = vertices[0].Position;
+            for (const Vertex &v : vertices)
+            {
+                bounds.aabbMin = glm::min(bounds.aabbMin, v.Position);
+                bounds.aabbMax = glm::max(bounds.aabbMax, v.Position);
+            }
+        }
+        bounds.center = (bounds.aabbMin + bounds.aabbMax) * 0.5f;
+        bounds.radius = 0.0f;
+        for (const Vertex &v : vertices)
+            bounds.radius = std::max(bounds.radius, glm::length(v.Position - bounds.center));
+
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
@@ -178,8 +328,14 @@ private:
 
 
 
+        // simplified copies of the triangles, drawn instead of the full mesh when it covers little of the screen
+        vector<MeshLod> lods;
+        BuildMeshLods(vertices, indices, lods);
+
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        Mesh result(vertices, indices, textures, lods);
+        result.bounds = bounds;
+        return result;
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -191,69 +347,33 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back(loadTexture(str.C_Str(), typeName));
         }
         return textures;
     }
+
+    // the TextureCache makes sure a file shared by several meshes or models is loaded only once. With
+    // gammaCorrection the diffuse maps are sampled as sRGB; specular, normal and height maps are data
+    Texture loadTexture(const string &path, const string &typeName)
+    {
+        Texture texture;
+        texture.id = TextureFromFile(path.c_str(), this->directory, gammaCorrection && typeName == "texture_diffuse");
+        texture.type = typeName;
+        texture.path = path;
+        textures_loaded.push_back(texture);
+        return texture;
+    }
 };
 
 
+// acquires the texture from the TextureCache, which decodes it on the TextureLoader's worker threads
+// the first time; the returned texture shows a placeholder until TextureLoader::ProcessUploads uploads the image.
+// every call must be matched by a TextureCache::Release
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return TextureCache::Instance().Acquire(filename, gamma ? TEXTURE_SRGB : TEXTURE_DEFAULT);
 }
 #endif
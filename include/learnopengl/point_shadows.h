@@ -0,0 +1,312 @@
+#ifndef POINT_SHADOWS_H
+#define POINT_SHADOWS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/shader_m.h>
+#include <learnopengl/scene.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/uniform_buffer.h>
+#include <learnopengl/light_source.h>
+#include <learnopengl/cascaded_shadows.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// texture units of the point light shadows, after the cascades
+enum PointShadowTextureUnit {
+    POINT_SHADOW_INFO_UNIT  = SHADOW_MAP_UNIT + 1,  // samplerBuffer pointShadowInfo, 2 RGBA32F texels per light
+    POINT_SHADOW_ATLAS_UNIT = SHADOW_MAP_UNIT + 2   // sampler2DShadow pointShadowAtlas
+};
+
+// Shadows of point lights. Each shadowed light gets a 3x2 block of square tiles in one depth atlas, one
+// tile per cube face, rendered with a 90 degree perspective out to the light's radius. The shaders pick the
+// face from the major axis of the light-to-fragment vector (faces in GL cube map order, see faceDirection).
+// Shadows are kept until something changes, and only a budget of lights is re-rendered each frame:
+//  - the atlas's blocks go to the most important lights that reach into the view (bright, large, close),
+//  - a light is re-rendered when it got its block, moved, or has a moving caster in its range,
+//    or when the Scene's static nodes changed; the most important first, at most budget lights a frame.
+// A light that got a block but hasn't been rendered yet stays unshadowed, a changed one keeps its old
+// shadow until its turn. For every light the shaders read from pointShadowInfo
+//     texel 0: atlas uv of the block, tile size in uv, far plane (x < 0: not shadowed)
+//     texel 1: near plane, 1 / tile size in texels
+class PointShadowAtlas
+{
+public:
+    static const unsigned int FACE_COUNT = 6;
+
+    unsigned int atlas = 0;
+    int atlasSize = 0;
+    int tileSize = 0;
+    unsigned int budget = 4;        // lights re-rendered per frame
+    float nearPlane = 0.05f;
+    unsigned int shadowedLights = 0;    // holding a rendered block, of the last Update
+    unsigned int refreshedLights = 0;   // rendered in the last Update
+
+    PointShadowAtlas()
+    {
+        glGenFramebuffers(1, &framebuffer);
+        glGenBuffers(1, &infoBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, infoBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, 2 * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+        glGenTextures(1, &infoTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, infoTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, infoBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    PointShadowAtlas(const PointShadowAtlas &) = delete;
+    PointShadowAtlas &operator=(const PointShadowAtlas &) = delete;
+
+    // points shader's samplers at their units
+    static void SetupShader(Shader &shader)
+    {
+        shader.use();
+        shader.setInt("pointShadowInfo", POINT_SHADOW_INFO_UNIT);
+        shader.setInt("pointShadowAtlas", POINT_SHADOW_ATLAS_UNIT);
+    }
+
+    // (re)creates the atlas; every block is given up and rendered again
+    void Resize(int atlasSize, int tileSize)
+    {
+        this->atlasSize = atlasSize;
+        this->tileSize = tileSize;
+        glDeleteTextures(1, &atlas);
+        glGenTextures(1, &atlas);
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, atlasSize, atlasSize, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, atlas, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::POINT_SHADOWS:: atlas framebuffer not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        blocksX = atlasSize / (3 * tileSize);
+        blocks.assign(blocksX * (atlasSize / (2 * tileSize)), Block());
+        blockOfLight.clear();
+    }
+
+    // hands the blocks to the lights that matter for a camera at viewPosition seeing frustum, re-renders up to
+    // budget of them and uploads pointShadowInfo for all of lights. A light is identified by its index, so
+    // lights should keep their place in the vector from frame to frame. enabled = false leaves every light
+    // unshadowed. Uses frameUbo like CascadedShadowMaps::Render and leaves the default framebuffer bound
+    void Update(const std::vector<PointLightSource> &lights, const Frustum &frustum, const glm::vec3 &viewPosition,
+                Scene &scene, RenderQueue &queue, const UniformBuffer<FrameData> &frameUbo, const FrameData &camera,
+                bool enabled = true)
+    {
+        refreshedLights = 0;
+        if (!enabled) {
+            blocks.assign(blocks.size(), Block());
+            blockOfLight.clear();
+        }
+        blockOfLight.resize(lights.size(), -1);
+        bool staticChanged = scene.staticVersion != staticVersionRendered;
+        staticVersionRendered = scene.staticVersion;
+
+        // the most important lights in view, as many as there are blocks
+        importance.assign(lights.size(), 0.0f);
+        candidates.clear();
+        for (unsigned int i = 0; i < lights.size() && enabled; i++) {
+            const PointLightSource &light = lights[i];
+            if (light.radius <= 0.0f || !frustum.IntersectsSphere(light.position, light.radius))
+                continue;
+            glm::vec3 color = light.diffuse + light.specular;
+            float distance = std::max(glm::length(light.position - viewPosition) - light.radius, 0.0f);
+            importance[i] = std::max(color.r, std::max(color.g, color.b)) * light.radius / (distance + light.radius);
+            // a light keeps its block against slightly more important ones, so blocks don't flip every frame
+            if (blockOfLight[i] != -1)
+                importance[i] *= 1.25f;
+            candidates.push_back(i);
+        }
+        std::sort(candidates.begin(), candidates.end(),
+                  [this](unsigned int a, unsigned int b) { return importance[a] > importance[b]; });
+        if (candidates.size() > blocks.size())
+            candidates.resize(blocks.size());
+        selected.assign(lights.size(), 0);
+        for (unsigned int i : candidates)
+            selected[i] = 1;
+
+        // lights that dropped out give their block back, new ones take free blocks
+        for (unsigned int b = 0; b < blocks.size(); b++) {
+            Block &block = blocks[b];
+            if (block.light != -1 && (block.light >= (int) lights.size() || !selected[block.light])) {
+                if (block.light < (int) lights.size())
+                    blockOfLight[block.light] = -1;
+                block = Block();
+            }
+        }
+        unsigned int freeBlock = 0;
+        for (unsigned int i : candidates) {
+            if (blockOfLight[i] != -1)
+                continue;
+            while (blocks[freeBlock].light != -1)
+                freeBlock++;
+            blocks[freeBlock].light = i;
+            blockOfLight[i] = freeBlock;
+        }
+
+        // what has to be rendered, the most important first
+        refresh.clear();
+        for (unsigned int b = 0; b < blocks.size(); b++) {
+            Block &block = blocks[b];
+            if (block.light == -1)
+                continue;
+            const PointLightSource &light = lights[block.light];
+            block.changed |= staticChanged || light.position != block.position || light.radius != block.radius ||
+                             scene.MovingMeshesIntersect(light.position, light.radius);
+            if (!block.rendered || block.changed)
+                refresh.push_back(b);
+        }
+        std::sort(refresh.begin(), refresh.end(), [this](unsigned int a, unsigned int b) {
+            // blocks without any shadow yet go before stale ones
+            if (blocks[a].rendered != blocks[b].rendered)
+                return !blocks[a].rendered;
+            return importance[blocks[a].light] > importance[blocks[b].light];
+        });
+        if (refresh.size() > budget)
+            refresh.resize(budget);
+
+        if (!refresh.empty()) {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glEnable(GL_SCISSOR_TEST);
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(2.0f, 4.0f);
+            for (unsigned int b : refresh)
+                render(b, lights[blocks[b].light], scene, queue, frameUbo, camera);
+            glPolygonOffset(0.0f, 0.0f);
+            glDisable(GL_POLYGON_OFFSET_FILL);
+            glDisable(GL_SCISSOR_TEST);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            frameUbo.update(camera);
+            refreshedLights = refresh.size();
+        }
+
+        // a block's shadow is used from its first rendering on
+        info.assign(std::max<size_t>(lights.size(), 1) * 2, glm::vec4(-1.0f, 0.0f, 0.0f, 0.0f));
+        shadowedLights = 0;
+        for (unsigned int b = 0; b < blocks.size(); b++) {
+            const Block &block = blocks[b];
+            if (block.light == -1 || !block.rendered)
+                continue;
+            glm::vec2 origin = blockOrigin(b);
+            info[2 * block.light] = glm::vec4(origin.x / atlasSize, origin.y / atlasSize, (float) tileSize / atlasSize, block.radius);
+            info[2 * block.light + 1] = glm::vec4(nearPlane, 1.0f / tileSize, 0.0f, 0.0f);
+            shadowedLights++;
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, infoBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, info.size() * sizeof(glm::vec4), info.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // binds the info buffer and the atlas to their units for the lighting passes
+    void Bind() const
+    {
+        glActiveTexture(GL_TEXTURE0 + POINT_SHADOW_INFO_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, infoTexture);
+        glActiveTexture(GL_TEXTURE0 + POINT_SHADOW_ATLAS_UNIT);
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // call it while the GL context is still alive
+    void Clear()
+    {
+        glDeleteTextures(1, &atlas);
+        glDeleteTextures(1, &infoTexture);
+        glDeleteBuffers(1, &infoBuffer);
+        glDeleteFramebuffers(1, &framebuffer);
+        atlas = infoTexture = infoBuffer = framebuffer = 0;
+    }
+
+    // the faces in GL cube map order, +X -X +Y -Y +Z -Z; the shaders keep the same table
+    static glm::vec3 faceDirection(unsigned int face)
+    {
+        const glm::vec3 directions[FACE_COUNT] = {
+            glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+            glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+        };
+        return directions[face];
+    }
+
+    static glm::vec3 faceUp(unsigned int face)
+    {
+        const glm::vec3 ups[FACE_COUNT] = {
+            glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+            glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+        };
+        return ups[face];
+    }
+
+private:
+    struct Block {
+        int light = -1;             // index of the light holding it, -1 if free
+        bool rendered = false;      // holds a shadow of that light
+        bool changed = false;       // the shadow is out of date
+        glm::vec3 position = glm::vec3(0.0f);   // of the light when it was rendered
+        float radius = 0.0f;
+    };
+
+    unsigned int framebuffer = 0;
+    unsigned int infoBuffer = 0, infoTexture = 0;
+    int blocksX = 0;
+    std::vector<Block> blocks;
+    std::vector<int> blockOfLight;
+    std::vector<float> importance;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned char> selected;    // per light, among candidates
+    std::vector<unsigned int> refresh;
+    std::vector<glm::vec4> info;
+    unsigned int staticVersionRendered = 0;
+
+    // lower left corner of a block in texels
+    glm::vec2 blockOrigin(unsigned int block) const
+    {
+        return glm::vec2((block % blocksX) * 3 * tileSize, (block / blocksX) * 2 * tileSize);
+    }
+
+    void render(unsigned int b, const PointLightSource &light, Scene &scene, RenderQueue &queue,
+                const UniformBuffer<FrameData> &frameUbo, const FrameData &camera)
+    {
+        Block &block = blocks[b];
+        glm::vec2 origin = blockOrigin(b);
+        FrameData frameData = camera;
+        frameData.projection = glm::perspective(glm::radians(90.0f), 1.0f, nearPlane, light.radius);
+        for (unsigned int face = 0; face < FACE_COUNT; face++) {
+            int x = (int) origin.x + (face % 3) * tileSize;
+            int y = (int) origin.y + (face / 3) * tileSize;
+            glViewport(x, y, tileSize, tileSize);
+            glScissor(x, y, tileSize, tileSize);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            frameData.view = glm::lookAt(light.position, light.position + faceDirection(face), faceUp(face));
+            frameUbo.update(frameData);
+            queue.Clear();
+            // full detail, as a tile can be kept for many frames while the camera moves
+            scene.Submit(queue, Frustum::FromMatrix(frameData.projection * frameData.view), light.position, SHADER_DEPTH,
+                         NODES_ALL, nullptr, false);
+            queue.Sort();
+            queue.Execute(true);
+        }
+        block.rendered = true;
+        block.changed = false;
+        block.position = light.position;
+        block.radius = light.radius;
+    }
+};
+#endif
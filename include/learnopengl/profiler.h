@@ -0,0 +1,172 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Measures how long each render pass of a frame takes on the CPU and on the GPU.
+// GPU times come from GL_TIME_ELAPSED queries. A query's result is only read FRAME_LATENCY frames
+// after it was issued, by which time the GPU has long finished it, so reading never stalls the pipeline.
+// Passes must not nest (GL allows one active GL_TIME_ELAPSED query at a time).
+//
+//     profiler.BeginFrame();
+//     profiler.Begin("scene"); ...draw... profiler.End();
+//     profiler.EndFrame();
+class Profiler
+{
+public:
+    static const unsigned int FRAME_LATENCY = 3;
+    static const unsigned int HISTORY = 240;   // frames kept for the frame time graph
+
+    struct Pass {
+        std::string name;
+        float cpuMs;    // averaged over the last frames
+        float gpuMs;
+        GLuint queries[FRAME_LATENCY];
+        bool issued[FRAME_LATENCY];     // query has a result nobody read yet
+        float lastCpuMs;
+    };
+
+    std::vector<Pass> passes;   // in the order they were first seen
+    float cpuFrameHistory[HISTORY] = {0};   // ring buffers, in milliseconds
+    float gpuFrameHistory[HISTORY] = {0};
+    unsigned int historyOffset = 0;     // index of the oldest entry
+    bool enabled = true;
+    unsigned int gpuFramesResolved = 0;     // frames whose GPU times have been read back so far
+
+    void BeginFrame()
+    {
+        frameStart = std::chrono::steady_clock::now();
+        slot = frame % FRAME_LATENCY;
+        // the queries of this slot were issued FRAME_LATENCY frames ago
+        float gpuFrameMs = 0.0f;
+        bool gpuFrameKnown = false;
+        for (Pass &pass : passes) {
+            if (!pass.issued[slot])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(pass.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(pass.queries[slot], GL_QUERY_RESULT, &nanoseconds);
+            pass.issued[slot] = false;
+            pass.gpuMs = smooth(pass.gpuMs, nanoseconds / 1.0e6f);
+            gpuFrameMs += nanoseconds / 1.0e6f;
+            gpuFrameKnown = true;
+        }
+        if (gpuFrameKnown) {
+            lastGpuFrameMs = gpuFrameMs;
+            gpuFramesResolved++;
+        }
+        current = -1;
+    }
+
+    void Begin(const char *name)
+    {
+        if (!enabled)
+            return;
+        current = findPass(name);
+        Pass &pass = passes[current];
+        // a query whose result never became available is simply overwritten
+        glBeginQuery(GL_TIME_ELAPSED, pass.queries[slot]);
+        passStart = std::chrono::steady_clock::now();
+    }
+
+    void End()
+    {
+        if (current == -1)
+            return;
+        Pass &pass = passes[current];
+        glEndQuery(GL_TIME_ELAPSED);
+        pass.issued[slot] = true;
+        pass.lastCpuMs = millisecondsSince(passStart);
+        pass.cpuMs = smooth(pass.cpuMs, pass.lastCpuMs);
+        current = -1;
+    }
+
+    void EndFrame()
+    {
+        cpuFrameHistory[historyOffset] = millisecondsSince(frameStart);
+        gpuFrameHistory[historyOffset] = lastGpuFrameMs;
+        historyOffset = (historyOffset + 1) % HISTORY;
+        frame++;
+    }
+
+    // total of the last recorded frame
+    float CpuFrameMs() const
+    {
+        return cpuFrameHistory[(historyOffset + HISTORY - 1) % HISTORY];
+    }
+
+    float GpuFrameMs() const
+    {
+        return lastGpuFrameMs;
+    }
+
+    // deletes the query objects; call it while the GL context is still alive
+    void Clear()
+    {
+        for (Pass &pass : passes)
+            glDeleteQueries(FRAME_LATENCY, pass.queries);
+        passes.clear();
+    }
+
+private:
+    unsigned int frame = 0;
+    unsigned int slot = 0;
+    int current = -1;
+    float lastGpuFrameMs = 0.0f;
+    std::chrono::steady_clock::time_point frameStart;
+    std::chrono::steady_clock::time_point passStart;
+
+    int findPass(const char *name)
+    {
+        for (unsigned int i = 0; i < passes.size(); i++)
+            if (passes[i].name == name)
+                return i;
+        Pass pass;
+        pass.name = name;
+        pass.cpuMs = pass.gpuMs = pass.lastCpuMs = 0.0f;
+        glGenQueries(FRAME_LATENCY, pass.queries);
+        for (bool &issued : pass.issued)
+            issued = false;
+        passes.push_back(pass);
+        return passes.size() - 1;
+    }
+
+    static float smooth(float average, float sample)
+    {
+        return average == 0.0f ? sample : average * 0.9f + sample * 0.1f;
+    }
+
+    static float millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+// times everything until the end of the enclosing scope as one pass
+class ProfileScope
+{
+public:
+    ProfileScope(Profiler &profiler, const char *name) : profiler(profiler)
+    {
+        profiler.Begin(name);
+    }
+
+    ~ProfileScope()
+    {
+        profiler.End();
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    Profiler &profiler;
+};
+#endif
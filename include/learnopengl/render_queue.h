@@ -0,0 +1,213 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader_m.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// GL calls issued by the last RenderQueue::Execute
+struct RenderQueueStats {
+    unsigned int draws;
+    unsigned int programBinds;
+    unsigned int textureBinds;
+    unsigned int vaoBinds;
+    unsigned int triangles;     // over all instances
+};
+
+// what the sort key puts first
+enum RenderQueueOrder {
+    SORT_BY_STATE,      // fewest state changes, for shading passes
+    SORT_FRONT_TO_BACK  // nearest first, so later draws fail the depth test early; for depth-only passes
+};
+
+// Collects the draws of a frame, sorts them by state and issues them with as few state changes as possible.
+// Every draw is described by a 64-bit key
+//     SORT_BY_STATE:      bits 63-56 shader | 55-40 material | 39-24 VAO | 23-0 depth (front to back)
+//     SORT_FRONT_TO_BACK: bits 63-40 depth | 39-32 shader | 31-16 VAO | 15-0 material
+// so sorting the keys groups draws by program first, then by the textures they sample, then by mesh.
+// Usage per frame: Clear, Submit/SubmitInstanced for every visible mesh, Sort, Execute.
+class RenderQueue
+{
+public:
+    RenderQueueStats stats = {0, 0, 0, 0, 0};
+    float depthRange = 100.0f;  // view distance mapped to the largest depth key, should match the far plane
+    RenderQueueOrder order = SORT_BY_STATE;     // applies to draws submitted afterwards
+
+    void Clear()
+    {
+        commands.clear();
+        keys.clear();
+        matrices.clear();
+    }
+
+    // draws level of detail lod of mesh once with shader, passing world through the model uniform
+    void Submit(Shader &shader, UniformHandle model, const Mesh &mesh, const glm::mat4 &world, float depth, unsigned int lod = 0)
+    {
+        push(shader, model, mesh, &world, 1, false, depth, lod);
+    }
+
+    // draws count copies of mesh with one instanced call; shader reads the matrices from the instance attribute.
+    // depth should be that of the nearest copy
+    void SubmitInstanced(Shader &shader, const Mesh &mesh, const glm::mat4 *worlds, unsigned int count, float depth, unsigned int lod = 0)
+    {
+        if (count > 0)
+            push(shader, UniformHandle(), mesh, worlds, count, true, depth, lod);
+    }
+
+    // LSD radix sort of the keys, one byte per pass. Passes over a byte that is the same in every key
+    // (e.g. the shader byte when everything uses one program) are skipped
+    void Sort()
+    {
+        unsigned int n = keys.size();
+        sortBuffer.resize(n);
+        SortKey *src = keys.data();
+        SortKey *dst = sortBuffer.data();
+        for (unsigned int shift = 0; shift < 64; shift += 8) {
+            unsigned int counts[256] = {0};
+            for (unsigned int i = 0; i < n; i++)
+                counts[(src[i].key >> shift) & 0xFF]++;
+            if (n == 0 || counts[(src[0].key >> shift) & 0xFF] == n)
+                continue;
+            unsigned int offsets[256];
+            unsigned int sum = 0;
+            for (unsigned int d = 0; d < 256; d++) {
+                offsets[d] = sum;
+                sum += counts[d];
+            }
+            for (unsigned int i = 0; i < n; i++)
+                dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+            std::swap(src, dst);
+        }
+        if (src != keys.data())
+            keys.swap(sortBuffer);
+    }
+
+    // issues the sorted draws, skipping glUseProgram, glBindTexture and glBindVertexArray calls
+    // that would bind what is already bound. depthOnly draws the position-only VAOs and binds no textures
+    void Execute(bool depthOnly = false)
+    {
+        stats.draws = stats.programBinds = stats.textureBinds = stats.vaoBinds = stats.triangles = 0;
+        // other code may have changed any of these since the last Execute
+        unsigned int currentProgram = 0, currentVAO = 0;
+        unsigned int currentTextures[SLOT_COUNT] = {0};
+        bool texturesKnown = false;
+
+        for (const SortKey &sortKey : keys) {
+            const Command &command = commands[sortKey.command];
+            if (command.shader->ID != currentProgram) {
+                command.shader->use();
+                currentProgram = command.shader->ID;
+                stats.programBinds++;
+            }
+            for (unsigned int slot = 0; slot < SLOT_COUNT && !depthOnly; slot++) {
+                unsigned int texture = command.mesh->slotTextures[slot];
+                if (texturesKnown && currentTextures[slot] == texture)
+                    continue;
+                glActiveTexture(GL_TEXTURE0 + slot);
+                glBindTexture(GL_TEXTURE_2D, texture);
+                currentTextures[slot] = texture;
+                stats.textureBinds++;
+            }
+            texturesKnown = true;
+            if (command.instanced)
+                command.mesh->UploadInstances(&matrices[command.firstMatrix], command.matrixCount);
+            else
+                command.shader->setMat4(command.model, matrices[command.firstMatrix]);
+            unsigned int vao = depthOnly ? command.mesh->depthVAO : command.mesh->VAO;
+            if (vao != currentVAO) {
+                glBindVertexArray(vao);
+                currentVAO = vao;
+                stats.vaoBinds++;
+            }
+            const MeshLod &lod = command.mesh->lods[command.lod];
+            void *firstIndex = (void *) (lod.firstIndex * sizeof(unsigned int));
+            if (command.instanced)
+                glDrawElementsInstanced(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT, firstIndex, command.matrixCount);
+            else
+                glDrawElements(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT, firstIndex);
+            stats.draws++;
+            stats.triangles += lod.indexCount / 3 * command.matrixCount;
+        }
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    unsigned int Size() const
+    {
+        return commands.size();
+    }
+
+private:
+    struct Command {
+        Shader *shader;
+        UniformHandle model;
+        const Mesh *mesh;
+        unsigned int firstMatrix;   // into matrices
+        unsigned int matrixCount;
+        unsigned int lod;           // into mesh->lods
+        bool instanced;
+    };
+
+    struct SortKey {
+        uint64_t key;
+        unsigned int command;
+    };
+
+    std::vector<Command> commands;
+    std::vector<SortKey> keys;
+    std::vector<SortKey> sortBuffer;
+    std::vector<glm::mat4> matrices;    // world matrices of all commands of the frame, reused between frames
+    std::vector<Shader *> shaders;      // shader index in the key
+
+    void push(Shader &shader, UniformHandle model, const Mesh &mesh, const glm::mat4 *worlds, unsigned int count,
+              bool instanced, float depth, unsigned int lod)
+    {
+        Command command;
+        command.shader = &shader;
+        command.model = model;
+        command.mesh = &mesh;
+        command.firstMatrix = matrices.size();
+        command.matrixCount = count;
+        command.lod = std::min(lod, (unsigned int) mesh.lods.size() - 1);
+        command.instanced = instanced;
+        matrices.insert(matrices.end(), worlds, worlds + count);
+
+        SortKey sortKey;
+        if (order == SORT_FRONT_TO_BACK)
+            sortKey.key = (quantizeDepth(depth) << 40)
+                        | (uint64_t(shaderIndex(shader) & 0xFF) << 32)
+                        | (uint64_t(mesh.VAO & 0xFFFF) << 16)
+                        | uint64_t(mesh.materialId & 0xFFFF);
+        else
+            sortKey.key = (uint64_t(shaderIndex(shader) & 0xFF) << 56)
+                        | (uint64_t(mesh.materialId & 0xFFFF) << 40)
+                        | (uint64_t(mesh.VAO & 0xFFFF) << 24)
+                        | quantizeDepth(depth);
+        sortKey.command = commands.size();
+        commands.push_back(command);
+        keys.push_back(sortKey);
+    }
+
+    unsigned int shaderIndex(Shader &shader)
+    {
+        for (unsigned int i = 0; i < shaders.size(); i++)
+            if (shaders[i] == &shader)
+                return i;
+        shaders.push_back(&shader);
+        return shaders.size() - 1;
+    }
+
+    uint64_t quantizeDepth(float depth) const
+    {
+        float t = std::min(std::max(depth / depthRange, 0.0f), 1.0f);
+        return uint64_t(t * 0xFFFFFF);
+    }
+};
+#endif
@@ -0,0 +1,164 @@
+#ifndef RENDER_TARGETS_H
+#define RENDER_TARGETS_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// a framebuffer with one color texture and, optionally, a depth texture
+struct RenderTarget {
+    unsigned int framebuffer;
+    unsigned int texture;
+    unsigned int depthTexture;  // 0 if the target has no depth
+    int width, height;
+    GLenum internalFormat;
+    bool inUse;
+    unsigned int lastUsedFrame;
+};
+
+// Hands out render targets by size and format, so passes don't own their intermediate images.
+// A target released by one pass is given to the next pass that asks for the same size and format, in the
+// same frame or a later one. After a resize or a render scale change the old sizes are simply no longer
+// asked for and are deleted by EndFrame once they've been idle for a while.
+class RenderTargetPool
+{
+public:
+    unsigned int maxIdleFrames = 60;
+
+    RenderTargetPool() = default;
+    RenderTargetPool(const RenderTargetPool &) = delete;
+    RenderTargetPool &operator=(const RenderTargetPool &) = delete;
+
+    // a free target of exactly this size and format, created if there is none. Color textures are
+    // linearly filtered and clamped to the edge, as every post-process pass wants them
+    RenderTarget &Acquire(int width, int height, GLenum internalFormat, bool depth = false)
+    {
+        for (std::unique_ptr<RenderTarget> &target : targets) {
+            if (!target->inUse && target->width == width && target->height == height
+                && target->internalFormat == internalFormat && (target->depthTexture != 0) == depth) {
+                target->inUse = true;
+                target->lastUsedFrame = frame;
+                return *target;
+            }
+        }
+        targets.push_back(std::unique_ptr<RenderTarget>(create(width, height, internalFormat, depth)));
+        return *targets.back();
+    }
+
+    // gives the target back; it stays allocated for the next Acquire of the same kind
+    void Release(RenderTarget &target)
+    {
+        target.inUse = false;
+        target.lastUsedFrame = frame;
+    }
+
+    // deletes targets nobody asked for in the last maxIdleFrames frames
+    void EndFrame()
+    {
+        for (unsigned int i = 0; i < targets.size();) {
+            RenderTarget &target = *targets[i];
+            if (!target.inUse && frame - target.lastUsedFrame > maxIdleFrames) {
+                destroy(target);
+                targets.erase(targets.begin() + i);
+            } else
+                i++;
+        }
+        frame++;
+    }
+
+    unsigned int Size() const
+    {
+        return targets.size();
+    }
+
+    // call it while the GL context is still alive
+    void Clear()
+    {
+        for (std::unique_ptr<RenderTarget> &target : targets)
+            destroy(*target);
+        targets.clear();
+    }
+
+private:
+    // unique_ptr keeps references handed out by Acquire valid while the vector grows
+    std::vector<std::unique_ptr<RenderTarget>> targets;
+    unsigned int frame = 0;
+
+    RenderTarget *create(int width, int height, GLenum internalFormat, bool depth)
+    {
+        RenderTarget *target = new RenderTarget();
+        target->width = width;
+        target->height = height;
+        target->internalFormat = internalFormat;
+        target->inUse = true;
+        target->lastUsedFrame = frame;
+
+        glGenFramebuffers(1, &target->framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+        glGenTextures(1, &target->texture);
+        glBindTexture(GL_TEXTURE_2D, target->texture);
+        GLenum format, type;
+        if (!transferFormat(internalFormat, format, type))
+            std::cout << "ERROR::RENDER_TARGET:: unsupported internal format 0x" << std::hex << internalFormat << std::dec << std::endl;
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->texture, 0);
+
+        // a texture rather than a renderbuffer, so later passes (HiZOcclusion) can read the depth
+        target->depthTexture = 0;
+        if (depth) {
+            glGenTextures(1, &target->depthTexture);
+            glBindTexture(GL_TEXTURE_2D, target->depthTexture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target->depthTexture, 0);
+        }
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::RENDER_TARGET:: framebuffer " << width << "x" << height << " not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return target;
+    }
+
+    // a pixel format and type glTexImage2D accepts together with internalFormat. Only normalized and
+    // floating point color formats are supported; anything else gets GL_RGBA, GL_FLOAT and false
+    static bool transferFormat(GLenum internalFormat, GLenum &format, GLenum &type)
+    {
+        type = GL_FLOAT;
+        switch (internalFormat) {
+        case GL_R8:             format = GL_RED;  type = GL_UNSIGNED_BYTE; return true;
+        case GL_RG8:            format = GL_RG;   type = GL_UNSIGNED_BYTE; return true;
+        case GL_RGB8:
+        case GL_SRGB8:          format = GL_RGB;  type = GL_UNSIGNED_BYTE; return true;
+        case GL_RGBA8:
+        case GL_SRGB8_ALPHA8:   format = GL_RGBA; type = GL_UNSIGNED_BYTE; return true;
+        case GL_R16F:
+        case GL_R32F:           format = GL_RED;  return true;
+        case GL_RG16F:
+        case GL_RG32F:          format = GL_RG;   return true;
+        case GL_RGB16F:
+        case GL_RGB32F:
+        case GL_R11F_G11F_B10F: format = GL_RGB;  return true;
+        case GL_RGBA16F:
+        case GL_RGBA32F:        format = GL_RGBA; return true;
+        }
+        format = GL_RGBA;
+        return false;
+    }
+
+    static void destroy(RenderTarget &target)
+    {
+        glDeleteFramebuffers(1, &target.framebuffer);
+        glDeleteTextures(1, &target.texture);
+        if (target.depthTexture)
+            glDeleteTextures(1, &target.depthTexture);
+    }
+};
+#endif
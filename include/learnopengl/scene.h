@@ -0,0 +1,460 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/model.h>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/hiz_occlusion.h>
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+enum SceneNodeFlags {
+    NODE_STATIC  = 0,
+    NODE_DYNAMIC = 1 << 0   // transform changes at runtime (animated objects)
+};
+
+// one placed object. local = T * Rx * Ry * Rz * S, world = parent.world * local
+struct SceneNode {
+    std::string name;
+    int model;      // index into Scene::models, -1 for pure transform nodes
+    int pass;       // index into Scene::passes
+    int parent;     // index of the parent node, -1 for roots. Parents are always stored before their children
+    glm::vec3 translation;
+    glm::vec3 rotation; // euler angles in degrees, applied x, then y, then z
+    glm::vec3 scale;
+    unsigned int flags;
+    bool moving;    // the node or one of its ancestors is dynamic
+
+    glm::mat4 world;
+    bool dirty;
+    int firstMesh;  // index of the node's first mesh in the culling arrays
+};
+
+// which nodes Submit draws
+enum SceneNodeFilter {
+    NODES_ALL,
+    NODES_STATIC,   // nodes that never move, e.g. for cached shadow maps
+    NODES_MOVING    // dynamic nodes and their descendants
+};
+
+// what a frame draws the scene for; every pass can have its own shaders for each
+enum SceneShaderVariant {
+    SHADER_FORWARD = 0,     // lit shading straight into the HDR target
+    SHADER_GBUFFER,         // material attributes into the deferred G-buffer
+    SHADER_DEPTH,           // depth only, for the pre-pass
+    SHADER_VARIANT_COUNT
+};
+
+// the shaders used to draw nodes of one kind; instanced is used when a model is placed more than once.
+// Variants without shaders are skipped by Submit
+struct ScenePass {
+    std::string name;
+    Shader *shader[SHADER_VARIANT_COUNT];
+    Shader *instancedShader[SHADER_VARIANT_COUNT];
+    UniformHandle model[SHADER_VARIANT_COUNT];
+};
+
+// all nodes that share a model and a pass; drawn with one instanced call per mesh
+struct SceneBatch {
+    int model;
+    int pass;
+    std::vector<int> nodes;
+    std::vector<glm::mat4> worlds;  // cached world matrices of nodes, rebuilt only when one of them changes
+    bool dirty;
+};
+
+// Scene loads object placements from a text file and caches their world transforms.
+// Each line of the file describes one node:
+//     name "model path" pass  tx ty tz  rx ry rz  scale  static|dynamic  [parent]
+// Empty lines and lines starting with '#' are ignored. The model path can be "-" for a node that only groups children.
+class Scene
+{
+public:
+    std::vector<SceneNode> nodes;
+    std::vector<std::unique_ptr<Model>> models;
+    std::vector<ScenePass> passes;
+    std::vector<SceneBatch> batches;
+    std::string textureNamePrefix = "material.";
+
+    // world space bounding spheres of every (node, mesh) pair, stored as separate arrays for CullSpheres
+    std::vector<float> cullX, cullY, cullZ, cullRadius;
+    std::vector<glm::vec3> cullBoxMin, cullBoxMax;  // and their world space boxes, for occlusion tests
+    std::vector<unsigned char> visible;
+    unsigned int visibleMeshes = 0;
+    unsigned int staticVersion = 0;     // changes whenever a node that isn't moving was nonetheless transformed
+
+    // Submit draws the coarsest LOD of a mesh whose error, projected onto the screen, stays within lodPixelError
+    // pixels. lodPixelsPerUnit is the size in pixels of one world unit one unit in front of the camera,
+    // see SetLodProjection; 0 (or lodPixelError 0) draws everything at full detail
+    float lodPixelsPerUnit = 0.0f;
+    float lodPixelError = 1.0f;
+
+    // registers the shaders used for nodes whose pass column is name and points their samplers at the
+    // fixed texture slots. Must be called before LoadFromFile
+    void AddPass(const std::string &name, Shader &shader, Shader &instancedShader)
+    {
+        ScenePass pass;
+        pass.name = name;
+        for (int i = 0; i < SHADER_VARIANT_COUNT; i++)
+            pass.shader[i] = pass.instancedShader[i] = nullptr;
+        passes.push_back(pass);
+        AddPassVariant(name, SHADER_FORWARD, shader, instancedShader);
+    }
+
+    // the shaders drawing an already added pass for another variant
+    void AddPassVariant(const std::string &name, SceneShaderVariant variant, Shader &shader, Shader &instancedShader)
+    {
+        int index = findPass(name);
+        if (index == -1) {
+            std::cout << "ERROR::SCENE:: unknown pass " << name << std::endl;
+            return;
+        }
+        ScenePass &pass = passes[index];
+        pass.shader[variant] = &shader;
+        pass.instancedShader[variant] = &instancedShader;
+        pass.model[variant] = shader.uniform("model");
+        SetMaterialSamplers(shader, textureNamePrefix);
+        SetMaterialSamplers(instancedShader, textureNamePrefix);
+    }
+
+    bool LoadFromFile(const std::string &filename)
+    {
+        std::ifstream in(filename);
+        if (!in) {
+            std::cout << "ERROR::SCENE:: could not open " << filename << std::endl;
+            return false;
+        }
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(in, line)) {
+            lineNumber++;
+            std::istringstream ls(line);
+            std::string name;
+            if (!(ls >> name) || name[0] == '#')
+                continue;
+
+            SceneNode node;
+            std::string modelPath, passName, flags, parentName;
+            float scale;
+            ls >> std::quoted(modelPath) >> passName
+               >> node.translation.x >> node.translation.y >> node.translation.z
+               >> node.rotation.x >> node.rotation.y >> node.rotation.z
+               >> scale >> flags;
+            if (!ls) {
+                std::cout << "ERROR::SCENE:: " << filename << ":" << lineNumber << " malformed node" << std::endl;
+                continue;
+            }
+            node.name = name;
+            node.scale = glm::vec3(scale);
+            node.flags = flags == "dynamic" ? NODE_DYNAMIC : NODE_STATIC;
+            node.parent = -1;
+            if (ls >> parentName) {
+                node.parent = Find(parentName);
+                if (node.parent == -1)
+                    std::cout << "ERROR::SCENE:: " << filename << ":" << lineNumber << " unknown parent " << parentName << std::endl;
+            }
+            node.moving = (node.flags & NODE_DYNAMIC) || (node.parent != -1 && nodes[node.parent].moving);
+            node.pass = findPass(passName);
+            if (node.pass == -1) {
+                std::cout << "ERROR::SCENE:: " << filename << ":" << lineNumber << " unknown pass " << passName << std::endl;
+                continue;
+            }
+            node.model = modelPath == "-" ? -1 : loadModel(modelPath);
+            node.dirty = true;
+            nodeIndex[node.name] = nodes.size();
+            nodes.push_back(node);
+        }
+        buildBatches();
+        Update();
+        return true;
+    }
+
+    // destroys all nodes and models, giving their textures back; call it while the GL context is still alive
+    void Clear()
+    {
+        nodes.clear();
+        batches.clear();
+        models.clear();
+        nodeIndex.clear();
+        modelIndex.clear();
+        batchOfNode.clear();
+        cullX.clear();
+        cullY.clear();
+        cullZ.clear();
+        cullRadius.clear();
+        cullBoxMin.clear();
+        cullBoxMax.clear();
+        visible.clear();
+    }
+
+    // the projection LODs are chosen for: vertical field of view in radians and the height of the viewport
+    void SetLodProjection(float fovY, int viewportHeight)
+    {
+        lodPixelsPerUnit = viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+    }
+
+    // returns the index of the named node or -1
+    int Find(const std::string &name) const
+    {
+        auto it = nodeIndex.find(name);
+        return it != nodeIndex.end() ? it->second : -1;
+    }
+
+    void SetTranslation(int node, const glm::vec3 &translation)
+    {
+        nodes[node].translation = translation;
+        nodes[node].dirty = true;
+    }
+
+    void SetRotation(int node, const glm::vec3 &rotation)
+    {
+        nodes[node].rotation = rotation;
+        nodes[node].dirty = true;
+    }
+
+    // recomputes world matrices of dirty nodes and their descendants; static scenery costs nothing here
+    void Update()
+    {
+        bool staticChanged = false;
+        for (unsigned int i = 0; i < nodes.size(); i++) {
+            SceneNode &node = nodes[i];
+            if (node.parent != -1 && nodes[node.parent].dirty)
+                node.dirty = true;
+            if (!node.dirty)
+                continue;
+            staticChanged |= !node.moving;
+            glm::mat4 local = glm::mat4(1.0f);
+            local = glm::translate(local, node.translation);
+            local = glm::rotate(local, glm::radians(node.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+            local = glm::rotate(local, glm::radians(node.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+            local = glm::rotate(local, glm::radians(node.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+            local = glm::scale(local, node.scale);
+            node.world = node.parent != -1 ? nodes[node.parent].world * local : local;
+            updateBounds(node);
+            if (batchOfNode[i] != -1)
+                batches[batchOfNode[i]].dirty = true;
+        }
+        for (SceneBatch &batch : batches) {
+            if (!batch.dirty)
+                continue;
+            for (unsigned int j = 0; j < batch.nodes.size(); j++)
+                batch.worlds[j] = nodes[batch.nodes[j]].world;
+            batch.dirty = false;
+        }
+        // dirty flags are only cleared once children had the chance to see them
+        for (SceneNode &node : nodes)
+            node.dirty = false;
+        if (staticChanged)
+            staticVersion++;
+    }
+
+    // culls every mesh of every node against the frustum and submits what is left to queue, drawn with the
+    // variant's shaders. Models placed more than once are submitted as one instanced draw per mesh, containing
+    // only the visible copies, one draw per LOD in use. With distanceLods every copy gets the LOD fitting its
+    // distance from viewPosition, otherwise the full detail one; passes whose results are kept across frames
+    // (the shadow maps) use full detail, so they never disagree with what the camera sees later. filter leaves
+    // out static or moving nodes; with occlusion, meshes that passed the frustum are also tested against the
+    // depth of earlier frames
+    void Submit(RenderQueue &queue, const Frustum &frustum, const glm::vec3 &viewPosition,
+                SceneShaderVariant variant = SHADER_FORWARD, SceneNodeFilter filter = NODES_ALL,
+                HiZOcclusion *occlusion = nullptr, bool distanceLods = true)
+    {
+        CullSpheres(frustum, cullX.data(), cullY.data(), cullZ.data(), cullRadius.data(), cullX.size(), visible.data());
+        bool testOcclusion = occlusion && occlusion->Ready();
+        visibleMeshes = 0;
+        for (unsigned int i = 0; i < visible.size(); i++) {
+            if (visible[i] && testOcclusion && occlusion->IsOccluded(cullBoxMin[i], cullBoxMax[i]))
+                visible[i] = 0;
+            visibleMeshes += visible[i];
+        }
+
+        for (SceneBatch &batch : batches) {
+            ScenePass &pass = passes[batch.pass];
+            if (!pass.shader[variant])
+                continue;
+            const Model &model = *models[batch.model];
+            if (batch.worlds.size() == 1) {
+                const SceneNode &node = nodes[batch.nodes[0]];
+                if (!passesFilter(node, filter))
+                    continue;
+                for (unsigned int i = 0; i < model.meshes.size(); i++) {
+                    unsigned int cull = node.firstMesh + i;
+                    if (!visible[cull])
+                        continue;
+                    float distance = viewDistance(cull, viewPosition);
+                    queue.Submit(*pass.shader[variant], pass.model[variant], model.meshes[i], batch.worlds[0], distance,
+                                 distanceLods ? selectLod(model.meshes[i], cull, distance) : 0);
+                }
+                continue;
+            }
+            for (unsigned int i = 0; i < model.meshes.size(); i++) {
+                for (unsigned int lod = 0; lod < MAX_MESH_LODS; lod++)
+                    visibleWorlds[lod].clear();
+                float depth[MAX_MESH_LODS] = {0.0f};
+                for (unsigned int j = 0; j < batch.nodes.size(); j++) {
+                    const SceneNode &node = nodes[batch.nodes[j]];
+                    unsigned int cull = node.firstMesh + i;
+                    if (!visible[cull] || !passesFilter(node, filter))
+                        continue;
+                    float distance = viewDistance(cull, viewPosition);
+                    unsigned int lod = distanceLods ? selectLod(model.meshes[i], cull, distance) : 0;
+                    depth[lod] = visibleWorlds[lod].empty() ? distance : std::min(depth[lod], distance);
+                    visibleWorlds[lod].push_back(batch.worlds[j]);
+                }
+                for (unsigned int lod = 0; lod < MAX_MESH_LODS; lod++)
+                    queue.SubmitInstanced(*pass.instancedShader[variant], model.meshes[i], visibleWorlds[lod].data(), visibleWorlds[lod].size(),
+                                          depth[lod], lod);
+            }
+        }
+    }
+
+    // whether a mesh of a moving node overlaps the sphere, i.e. the shadows cast inside it can change
+    bool MovingMeshesIntersect(const glm::vec3 &center, float radius) const
+    {
+        for (const SceneNode &node : nodes) {
+            if (!node.moving || node.model == -1)
+                continue;
+            for (unsigned int i = 0; i < models[node.model]->meshes.size(); i++) {
+                unsigned int cull = node.firstMesh + i;
+                float reach = radius + cullRadius[cull];
+                glm::vec3 offset = glm::vec3(cullX[cull], cullY[cull], cullZ[cull]) - center;
+                if (glm::dot(offset, offset) < reach * reach)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::unordered_map<std::string, int> nodeIndex;
+    std::unordered_map<std::string, int> modelIndex;
+    std::vector<int> batchOfNode;
+    std::vector<glm::mat4> visibleWorlds[MAX_MESH_LODS];    // of the instanced copies drawn at each LOD
+
+    // moves the model space spheres and boxes of the node's meshes into world space
+    void updateBounds(const SceneNode &node)
+    {
+        if (node.model == -1)
+            return;
+        const Model &model = *models[node.model];
+        float scale = std::max(glm::length(glm::vec3(node.world[0])),
+                               std::max(glm::length(glm::vec3(node.world[1])), glm::length(glm::vec3(node.world[2]))));
+        for (unsigned int i = 0; i < model.meshes.size(); i++) {
+            const Bounds &bounds = model.meshes[i].bounds;
+            glm::vec3 center = glm::vec3(node.world * glm::vec4(bounds.center, 1.0f));
+            cullX[node.firstMesh + i] = center.x;
+            cullY[node.firstMesh + i] = center.y;
+            cullZ[node.firstMesh + i] = center.z;
+            cullRadius[node.firstMesh + i] = bounds.radius * scale;
+
+            // the box around the transformed box: each axis of the world matrix widens it by its extent
+            glm::vec3 boxMin = glm::vec3(node.world[3]), boxMax = boxMin;
+            for (int axis = 0; axis < 3; axis++) {
+                glm::vec3 a = glm::vec3(node.world[axis]) * bounds.aabbMin[axis];
+                glm::vec3 b = glm::vec3(node.world[axis]) * bounds.aabbMax[axis];
+                boxMin += glm::min(a, b);
+                boxMax += glm::max(a, b);
+            }
+            cullBoxMin[node.firstMesh + i] = boxMin;
+            cullBoxMax[node.firstMesh + i] = boxMax;
+        }
+    }
+
+    // distance from the viewer to the nearest point of a culling sphere, used to sort draws front to back
+    float viewDistance(unsigned int cull, const glm::vec3 &viewPosition) const
+    {
+        glm::vec3 center(cullX[cull], cullY[cull], cullZ[cull]);
+        return std::max(glm::length(center - viewPosition) - cullRadius[cull], 0.0f);
+    }
+
+    // the coarsest LOD of the mesh whose error, scaled like the culling sphere and seen from distance, is small enough
+    unsigned int selectLod(const Mesh &mesh, unsigned int cull, float distance) const
+    {
+        if (lodPixelsPerUnit <= 0.0f || lodPixelError <= 0.0f || mesh.bounds.radius <= 0.0f)
+            return 0;
+        float scale = cullRadius[cull] / mesh.bounds.radius;
+        float pixelsPerError = scale * lodPixelsPerUnit / std::max(distance, 1.0e-3f);
+        // visibleWorlds has room for MAX_MESH_LODS, whatever the mesh came with
+        unsigned int lodCount = std::min<size_t>(mesh.lods.size(), MAX_MESH_LODS);
+        unsigned int lod = 0;
+        while (lod + 1 < lodCount && mesh.lods[lod + 1].error * pixelsPerError <= lodPixelError)
+            lod++;
+        return lod;
+    }
+
+    static bool passesFilter(const SceneNode &node, SceneNodeFilter filter)
+    {
+        return filter == NODES_ALL || node.moving == (filter == NODES_MOVING);
+    }
+
+    int findPass(const std::string &name) const
+    {
+        for (unsigned int i = 0; i < passes.size(); i++)
+            if (passes[i].name == name)
+                return i;
+        return -1;
+    }
+
+    // every model file is loaded once, no matter how many nodes place it
+    int loadModel(const std::string &path)
+    {
+        auto it = modelIndex.find(path);
+        if (it != modelIndex.end())
+            return it->second;
+        models.push_back(std::unique_ptr<Model>(new Model(path, true)));
+        modelIndex[path] = models.size() - 1;
+        return models.size() - 1;
+    }
+
+    // groups nodes by (model, pass), keeping the order in which they first appear in the file
+    void buildBatches()
+    {
+        batches.clear();
+        batchOfNode.assign(nodes.size(), -1);
+        unsigned int meshCount = 0;
+        for (unsigned int i = 0; i < nodes.size(); i++) {
+            SceneNode &node = nodes[i];
+            node.firstMesh = meshCount;
+            if (node.model == -1)
+                continue;
+            meshCount += models[node.model]->meshes.size();
+            int found = -1;
+            for (unsigned int b = 0; b < batches.size(); b++)
+                if (batches[b].model == node.model && batches[b].pass == node.pass)
+                    found = b;
+            if (found == -1) {
+                SceneBatch batch;
+                batch.model = node.model;
+                batch.pass = node.pass;
+                batch.dirty = true;
+                batches.push_back(batch);
+                found = batches.size() - 1;
+            }
+            batches[found].nodes.push_back(i);
+            batches[found].worlds.push_back(glm::mat4(1.0f));
+            batchOfNode[i] = found;
+        }
+        cullX.assign(meshCount, 0.0f);
+        cullY.assign(meshCount, 0.0f);
+        cullZ.assign(meshCount, 0.0f);
+        cullRadius.assign(meshCount, 0.0f);
+        cullBoxMin.assign(meshCount, glm::vec3(0.0f));
+        cullBoxMax.assign(meshCount, glm::vec3(0.0f));
+        visible.assign(meshCount, 1);
+    }
+};
+#endif
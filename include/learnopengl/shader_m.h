@@ -8,7 +8,19 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 #include <common.h>
+
+// location of a uniform resolved once at link time, so setting it in the render loop
+// needs neither a string lookup nor a glGetUniformLocation round-trip to the driver
+struct UniformHandle
+{
+    GLint location;
+
+    explicit UniformHandle(GLint location = -1) : location(location) {}
+    bool valid() const { return location != -1; }
+};
+
 class Shader
 {
 public:
@@ -76,6 +88,7 @@ public:
         glDeleteShader(vertex);
         glDeleteShader(fragment);
 
+        introspectUniforms();
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -83,66 +96,175 @@ public:
     { 
         glUseProgram(ID); 
     }
+    // returns a handle to the named uniform; resolve these once outside of the render loop.
+    // unknown or optimized-out uniforms give an invalid handle, which the setters silently ignore (like location -1 in GL)
+    // ------------------------------------------------------------------------
+    UniformHandle uniform(const std::string &name) const
+    {
+        return UniformHandle(location(name));
+    }
+    // attaches the named uniform block to a binding point (GLSL 330 has no layout(binding = N))
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const std::string &blockName, GLuint binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(ID, blockName.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(location(name), (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(location(name), value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(location(name), value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(location(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(location(name), x, y); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(location(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(location(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(location(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) const
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(location(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
+    }
+    // handle based setters, used in the hot loop
+    // ------------------------------------------------------------------------
+    void setBool(UniformHandle handle, bool value) const
+    {
+        glUniform1i(handle.location, (int)value);
+    }
+    void setInt(UniformHandle handle, int value) const
+    {
+        glUniform1i(handle.location, value);
+    }
+    void setFloat(UniformHandle handle, float value) const
+    {
+        glUniform1f(handle.location, value);
+    }
+    // sets count elements of a float array uniform, starting at the element handle refers to
+    void setFloatArray(UniformHandle handle, const float *values, int count) const
+    {
+        glUniform1fv(handle.location, count, values);
+    }
+    void setVec2(UniformHandle handle, const glm::vec2 &value) const
+    {
+        glUniform2fv(handle.location, 1, &value[0]);
+    }
+    void setIVec2(UniformHandle handle, const glm::ivec2 &value) const
+    {
+        glUniform2i(handle.location, value.x, value.y);
+    }
+    void setVec3(UniformHandle handle, const glm::vec3 &value) const
+    {
+        glUniform3fv(handle.location, 1, &value[0]);
+    }
+    void setVec3(UniformHandle handle, float x, float y, float z) const
+    {
+        glUniform3f(handle.location, x, y, z);
+    }
+    void setVec4(UniformHandle handle, const glm::vec4 &value) const
+    {
+        glUniform4fv(handle.location, 1, &value[0]);
+    }
+    void setMat3(UniformHandle handle, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(UniformHandle handle, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+protected:
+    // for shaders built from other stages (see ComputeShader); ID is set by the derived constructor
+    Shader() : ID(0) {}
+
+    // name -> location of every active uniform, filled once after linking
+    std::unordered_map<std::string, GLint> uniformLocations;
+
+    GLint location(const std::string &name) const
+    {
+        auto it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+
+    // queries all active uniforms of the linked program. Arrays are reported once as "name[0]"
+    // so every element is registered separately, as well as the bare array name.
+    // Members of uniform blocks have no location and are skipped.
+    // ------------------------------------------------------------------------
+    void introspectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string buffer(maxLength > 0 ? maxLength : 1, '\0');
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, (GLuint)i, maxLength, &length, &size, &type, &buffer[0]);
+            std::string name(buffer.data(), length);
+            GLint loc = glGetUniformLocation(ID, name.c_str());
+            if (loc == -1)
+                continue;
+            uniformLocations[name] = loc;
+
+            std::string::size_type bracket = name.rfind("[0]");
+            if (bracket == std::string::npos || bracket + 3 != name.size())
+                continue;
+            std::string base = name.substr(0, bracket);
+            uniformLocations[base] = loc;
+            for (GLint j = 1; j < size; j++)
+            {
+                std::string element = base + "[" + std::to_string(j) + "]";
+                uniformLocations[element] = glGetUniformLocation(ID, element.c_str());
+            }
+        }
     }
 
-private:
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
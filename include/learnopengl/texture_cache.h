@@ -0,0 +1,106 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <learnopengl/texture_loader.h>
+
+#include <climits>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum TextureFlags {
+    TEXTURE_DEFAULT     = 0,
+    TEXTURE_CLAMP_ALPHA = 1 << 0,   // GL_CLAMP_TO_EDGE for images with an alpha channel
+    TEXTURE_SRGB        = 1 << 1    // color data stored gamma encoded, decoded to linear when sampled
+};
+
+// Process-wide, reference counted texture cache. Every image file (identified by its canonical
+// absolute path and the flags it is decoded and sampled with, sRGB included) is decoded and uploaded exactly once, no matter
+// how many models or meshes use it, and deleted when the last user releases it.
+class TextureCache
+{
+public:
+    static TextureCache &Instance()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    unsigned int Acquire(const std::string &path, unsigned int flags = TEXTURE_DEFAULT)
+    {
+        std::string key = canonicalPath(path) + '|' + std::to_string(flags);
+        auto it = byKey.find(key);
+        if (it != byKey.end()) {
+            byId[it->second].refCount++;
+            return it->second;
+        }
+        unsigned int id = TextureLoader::Instance().Load2D(path, (flags & TEXTURE_CLAMP_ALPHA) != 0, (flags & TEXTURE_SRGB) != 0);
+        insert(key, id);
+        return id;
+    }
+
+    // faces in the order +x, -x, +y, -y, +z, -z
+    unsigned int AcquireCubemap(const std::vector<std::string> &faces)
+    {
+        std::string key = "cube";
+        for (const std::string &face : faces)
+            key += '|' + canonicalPath(face);
+        auto it = byKey.find(key);
+        if (it != byKey.end()) {
+            byId[it->second].refCount++;
+            return it->second;
+        }
+        unsigned int id = TextureLoader::Instance().LoadCubemap(faces);
+        insert(key, id);
+        return id;
+    }
+
+    // drops one reference; the texture is deleted when nobody uses it anymore. Needs a current GL context
+    void Release(unsigned int textureID)
+    {
+        auto it = byId.find(textureID);
+        if (it == byId.end())
+            return;
+        if (--it->second.refCount > 0)
+            return;
+        // an image still on its way must not be uploaded into the deleted name, which GL may hand out again
+        TextureLoader::Instance().Cancel(textureID);
+        glDeleteTextures(1, &textureID);
+        byKey.erase(it->second.key);
+        byId.erase(it);
+    }
+
+    unsigned int Size() const
+    {
+        return byId.size();
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        unsigned int refCount;
+    };
+
+    std::unordered_map<std::string, unsigned int> byKey;
+    std::unordered_map<unsigned int, Entry> byId;
+
+    void insert(const std::string &key, unsigned int id)
+    {
+        byKey[key] = id;
+        Entry entry;
+        entry.key = key;
+        entry.refCount = 1;
+        byId[id] = entry;
+    }
+
+    // "a/b/../c.jpg" and "./a/c.jpg" name the same file; fall back to the given path if it doesn't exist
+    static std::string canonicalPath(const std::string &path)
+    {
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved))
+            return std::string(resolved);
+        return path;
+    }
+};
+#endif
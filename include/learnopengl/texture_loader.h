@@ -0,0 +1,282 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Decodes image files on a pool of worker threads and uploads them on the GL thread.
+// Load2D/LoadCubemap return a texture name immediately; it holds a 1x1 placeholder until
+// ProcessUploads (called once per frame from the render loop) replaces it with the decoded image.
+class TextureLoader
+{
+public:
+    static TextureLoader &Instance()
+    {
+        static TextureLoader loader;
+        return loader;
+    }
+
+    // clampAlpha: use GL_CLAMP_TO_EDGE for images with an alpha channel, to prevent semi-transparent borders.
+    // srgb: the color channels are gamma encoded and stored as GL_SRGB8(_ALPHA8)
+    unsigned int Load2D(const std::string &path, bool clampAlpha = false, bool srgb = false)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        const unsigned char placeholder[4] = {128, 128, 128, 255};
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        Job job;
+        job.textureID = textureID;
+        job.serial = nextSerial++;
+        job.target = GL_TEXTURE_2D;
+        job.path = path;
+        job.clampAlpha = clampAlpha;
+        job.srgb = srgb;
+        enqueue(job);
+        return textureID;
+    }
+
+    // faces in the order +x, -x, +y, -y, +z, -z
+    unsigned int LoadCubemap(const std::vector<std::string> &faces)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        const unsigned char placeholder[3] = {0, 0, 0};
+        for (unsigned int i = 0; i < 6; i++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, placeholder);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+        unsigned int serial = nextSerial++;
+        for (unsigned int i = 0; i < faces.size() && i < 6; i++) {
+            Job job;
+            job.textureID = textureID;
+            job.serial = serial;
+            job.target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
+            job.path = faces[i];
+            job.clampAlpha = false;
+            job.srgb = false;
+            enqueue(job);
+        }
+        return textureID;
+    }
+
+    // uploads up to maxUploads decoded images; must be called on the thread that owns the GL context.
+    // returns the number of textures uploaded
+    unsigned int ProcessUploads(unsigned int maxUploads = ~0u)
+    {
+        std::vector<Result> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            unsigned int n = std::min<size_t>(maxUploads, decoded.size());
+            ready.assign(decoded.begin(), decoded.begin() + n);
+            decoded.erase(decoded.begin(), decoded.begin() + n);
+        }
+        for (Result &result : ready)
+            upload(result);
+        return ready.size();
+    }
+
+    // drops every image still queued, being decoded or waiting for upload into textureID, e.g. because the
+    // texture is about to be deleted. Must be called on the GL thread, like ProcessUploads. Jobs are matched
+    // by the serial of the load, not by the texture name: once deleted, GL may give the name to a new load
+    // whose images must survive
+    void Cancel(unsigned int textureID)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto live = loadSerial.find(textureID);
+        if (live == loadSerial.end())
+            return;
+        unsigned int serial = live->second;
+        loadSerial.erase(live);
+        for (auto it = jobs.begin(); it != jobs.end(); ) {
+            if (it->serial == serial) {
+                it = jobs.erase(it);
+                inFlight--;
+            } else {
+                ++it;
+            }
+        }
+        for (auto it = decoded.begin(); it != decoded.end(); ) {
+            if (it->job.serial == serial) {
+                stbi_image_free(it->data);
+                it = decoded.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        // images a worker is decoding right now are thrown away once it is done
+        if (std::find(decoding.begin(), decoding.end(), serial) != decoding.end())
+            cancelled.push_back(serial);
+    }
+
+    // blocks until every queued image is decoded and uploaded
+    void Finish()
+    {
+        while (Pending() > 0) {
+            ProcessUploads();
+            std::unique_lock<std::mutex> lock(mutex);
+            decodedCondition.wait(lock, [this] { return !decoded.empty() || inFlight == 0; });
+        }
+    }
+
+    // images queued or decoded but not uploaded yet
+    unsigned int Pending()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return inFlight + decoded.size();
+    }
+
+    ~TextureLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobCondition.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+        for (Result &result : decoded)
+            stbi_image_free(result.data);
+    }
+
+private:
+    struct Job {
+        unsigned int textureID;
+        unsigned int serial;    // of the Load2D/LoadCubemap call, shared by the faces of a cube map
+        GLenum target;      // GL_TEXTURE_2D or one of the cube map faces
+        std::string path;
+        bool clampAlpha;
+        bool srgb;
+    };
+
+    struct Result {
+        Job job;
+        unsigned char *data;
+        int width, height, components;
+    };
+
+    std::vector<std::thread> workers;
+    std::deque<Job> jobs;
+    std::vector<Result> decoded;
+    unsigned int inFlight = 0;  // jobs queued or being decoded
+    std::vector<unsigned int> decoding;     // serials of the jobs workers are decoding, one entry per job
+    std::vector<unsigned int> cancelled;    // serials among those Cancel was called for
+    std::unordered_map<unsigned int, unsigned int> loadSerial;  // texture name -> serial of the load filling it
+    unsigned int nextSerial = 0;            // only touched on the GL thread
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable jobCondition;
+    std::condition_variable decodedCondition;
+
+    TextureLoader()
+    {
+        unsigned int threads = std::max(1u, std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1u);
+        for (unsigned int i = 0; i < threads; i++)
+            workers.emplace_back(&TextureLoader::workerLoop, this);
+    }
+
+    void enqueue(const Job &job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(job);
+            loadSerial[job.textureID] = job.serial;
+            inFlight++;
+        }
+        jobCondition.notify_one();
+    }
+
+    void workerLoop()
+    {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobCondition.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+                job = jobs.front();
+                jobs.pop_front();
+                decoding.push_back(job.serial);
+            }
+            Result result;
+            result.job = job;
+            result.data = stbi_load(job.path.c_str(), &result.width, &result.height, &result.components, 0);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                decoding.erase(std::find(decoding.begin(), decoding.end(), job.serial));
+                auto wasCancelled = std::find(cancelled.begin(), cancelled.end(), job.serial);
+                if (wasCancelled != cancelled.end()) {
+                    stbi_image_free(result.data);
+                    // other faces of the same cube map may still be decoding
+                    if (std::find(decoding.begin(), decoding.end(), job.serial) == decoding.end())
+                        cancelled.erase(wasCancelled);
+                } else {
+                    decoded.push_back(result);
+                }
+                inFlight--;
+            }
+            decodedCondition.notify_all();
+        }
+    }
+
+    void upload(Result &result)
+    {
+        const Job &job = result.job;
+        if (!result.data) {
+            std::cout << "Texture failed to load at path: " << job.path << std::endl;
+            return;
+        }
+        GLenum format = GL_RGB;
+        if (result.components == 1)
+            format = GL_RED;
+        else if (result.components == 3)
+            format = GL_RGB;
+        else if (result.components == 4)
+            format = GL_RGBA;
+        // single channel images are data (e.g. specular masks), never gamma encoded
+        GLenum internalFormat = format;
+        if (job.srgb && format == GL_RGB)
+            internalFormat = GL_SRGB8;
+        else if (job.srgb && format == GL_RGBA)
+            internalFormat = GL_SRGB8_ALPHA8;
+
+        // rows of 1 and 3 component images are not necessarily 4 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (job.target == GL_TEXTURE_2D) {
+            glBindTexture(GL_TEXTURE_2D, job.textureID);
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, result.width, result.height, 0, format, GL_UNSIGNED_BYTE, result.data);
+            glGenerateMipmap(GL_TEXTURE_2D);
+
+            GLenum wrap = job.clampAlpha && format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        } else {
+            glBindTexture(GL_TEXTURE_CUBE_MAP, job.textureID);
+            glTexImage2D(job.target, 0, GL_RGB, result.width, result.height, 0, format, GL_UNSIGNED_BYTE, result.data);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        stbi_image_free(result.data);
+    }
+};
+#endif
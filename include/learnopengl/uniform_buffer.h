@@ -0,0 +1,89 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// binding points of the uniform blocks shared between shaders.
+// every shader that declares a block gets it bound with Shader::bindUniformBlock
+enum UniformBlockBinding {
+    FRAME_DATA_BINDING = 0,
+    LIGHT_DATA_BINDING = 1,
+    CLUSTER_DATA_BINDING = 2,
+    SHADOW_DATA_BINDING = 3
+};
+
+// C++ mirrors of the std140 blocks declared in the shaders. vec3 members are padded to 16 bytes,
+// a float that follows a vec3 takes the vec3's padding slot, and structs are rounded up to 16 bytes.
+// ------------------------------------------------------------------------
+// layout (std140) uniform FrameData
+struct FrameData {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec4 viewPosition;
+};
+
+struct DirLightStd140 {
+    glm::vec3 direction;
+    float pad0;
+    glm::vec3 ambient;
+    float pad1;
+    glm::vec3 diffuse;
+    float pad2;
+    glm::vec3 specular;
+    float pad3;
+};
+
+struct SpotLightStd140 {
+    glm::vec3 position;
+    float pad0;
+    glm::vec3 direction;
+    float cutOff;
+    float outerCutOff;
+    float pad1[3];
+    glm::vec3 specular;
+    float pad2;
+    glm::vec3 diffuse;
+    float pad3;
+    glm::vec3 ambient;
+    float constant;
+    float linear;
+    float quadratic;
+    float pad4[2];
+};
+
+// layout (std140) uniform LightData. Point lights are not part of it, see PointLightSource
+struct LightData {
+    DirLightStd140 dirLight;
+    SpotLightStd140 spotLight;
+};
+
+static_assert(sizeof(FrameData) == 144, "FrameData does not match the std140 layout");
+static_assert(sizeof(DirLightStd140) == 64, "DirLight does not match the std140 layout");
+static_assert(sizeof(SpotLightStd140) == 112, "SpotLight does not match the std140 layout");
+
+// a uniform buffer holding one T, permanently bound to its binding point
+template <typename T>
+class UniformBuffer
+{
+public:
+    unsigned int ID;
+
+    explicit UniformBuffer(GLuint binding)
+    {
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+    }
+
+    // uploads the whole block, once per frame
+    void update(const T &data) const
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+};
+#endif
@@ -1,13 +1,14 @@
 #version 330 core
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
 
+// a PointLightSource, read from pointLightData
 struct PointLight {
     vec3 position;
+    float radius;
 
-    vec3 specular;
-    vec3 diffuse;
     vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
 
     float constant;
     float linear;
@@ -50,17 +51,64 @@ in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
 
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+};
 
-#define NR_POINT_LIGHTS 2
+layout (std140) uniform LightData {
+    DirLight dirLight;
+    SpotLight spotLight;
+};
+
+// clustered point lights, see ClusteredLights
+layout (std140) uniform ClusterData {
+    uvec4 clusterGrid;      // tiles x, tiles y, depth slices
+    vec4 clusterParams;     // slice = log(view depth) * x + y; tile = pixel * zw
+};
+uniform samplerBuffer pointLightData;   // 4 texels per light
+uniform usamplerBuffer clusterLights;   // (first index, count) per cluster
+uniform usamplerBuffer lightIndices;
+
+// cascaded shadow maps of dirLight, see CascadedShadowMaps
+layout (std140) uniform ShadowData {
+    mat4 lightSpace[4];
+    vec4 cascadeSplits;     // view depth where each cascade ends
+    vec4 cascadeTexels;     // world size of a shadow map texel
+    vec4 shadowParams;      // cascade count (0 = off), 1 / resolution, PCF radius in texels, depth bias
+};
+uniform sampler2DArrayShadow shadowMap;
+// point light shadows, see PointShadowAtlas
+uniform samplerBuffer pointShadowInfo;  // 2 texels per light
+uniform sampler2DShadow pointShadowAtlas;
 
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
-uniform DirLight dirLight;
 uniform Material material;
-uniform vec3 viewPosition;
 
-//calculates the color when using a directional light.
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+// fraction of dirLight reaching fragPos, PCF filtered in the cascade that covers viewDepth
+float CalcShadow(vec3 fragPos, vec3 normal, vec3 lightDir, float viewDepth)
+{
+    int cascadeCount = int(shadowParams.x);
+    if (cascadeCount == 0 || viewDepth > cascadeSplits[cascadeCount - 1])
+        return 1.0;
+    int cascade = 0;
+    while (cascade < cascadeCount - 1 && viewDepth > cascadeSplits[cascade])
+        cascade++;
+    // looking up a point pushed out along the normal keeps surfaces from shadowing themselves at grazing angles
+    float grazing = 1.0 - max(dot(normal, lightDir), 0.0);
+    vec3 position = fragPos + normal * cascadeTexels[cascade] * (0.5 + grazing);
+    vec3 coords = (lightSpace[cascade] * vec4(position, 1.0)).xyz * 0.5 + 0.5;
+    float reference = coords.z - shadowParams.w;
+    int radius = int(shadowParams.z);
+    float lit = 0.0;
+    for (int x = -radius; x <= radius; x++)
+        for (int y = -radius; y <= radius; y++)
+            lit += texture(shadowMap, vec4(coords.xy + vec2(x, y) * shadowParams.y, float(cascade), reference));
+    return lit / float((2 * radius + 1) * (2 * radius + 1));
+}
+
+//calculates the color when using a directional light; shadow dims all but the ambient part.
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow)
 {
     vec3 lightDir = normalize(-light.direction);
     // diffuse shading
@@ -74,11 +122,53 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
     vec3 specular = light.specular * spec * vec3(texture(material.texture_diffuse1, TexCoords));
-    return (ambient + diffuse + specular);
+    return (ambient + (diffuse + specular) * shadow);
+}
+
+// fraction of a point light reaching fragPos, from its tiles in the shadow atlas (see PointShadowAtlas)
+const vec3 faceDirections[6] = vec3[](vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0),
+                                      vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+const vec3 faceUps[6] = vec3[](vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0),
+                               vec3(0.0, 0.0, -1.0), vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0));
+
+float CalcPointShadow(int index, vec3 lightPosition, vec3 fragPos, vec3 normal)
+{
+    vec4 block = texelFetch(pointShadowInfo, 2 * index);
+    if (block.x < 0.0)
+        return 1.0;
+    vec4 params = texelFetch(pointShadowInfo, 2 * index + 1);
+    float nearPlane = params.x;
+    float farPlane = block.w;
+    vec3 toFrag = fragPos - lightPosition;
+    // pushed out along the normal by about a texel at this distance
+    toFrag += normal * (2.0 * params.y * length(toFrag));
+    vec3 a = abs(toFrag);
+    int face = a.x >= a.y && a.x >= a.z ? (toFrag.x > 0.0 ? 0 : 1)
+             : a.y >= a.z ? (toFrag.y > 0.0 ? 2 : 3) : (toFrag.z > 0.0 ? 4 : 5);
+    // the face's view space, as glm::lookAt builds it
+    vec3 forward = faceDirections[face];
+    vec3 right = normalize(cross(forward, faceUps[face]));
+    vec3 up = cross(right, forward);
+    float depth = dot(toFrag, forward);
+    vec2 ndc = vec2(dot(toFrag, right), dot(toFrag, up)) / depth;
+    float ndcDepth = (farPlane + nearPlane) / (farPlane - nearPlane) - 2.0 * farPlane * nearPlane / ((farPlane - nearPlane) * depth);
+    // stay half a texel inside the tile, so filtering never reads the neighbouring face
+    vec2 tileUv = clamp(ndc * 0.5 + 0.5, 0.5 * params.y, 1.0 - 0.5 * params.y);
+    vec2 uv = block.xy + (vec2(face % 3, face / 3) + tileUv) * block.z;
+    return texture(pointShadowAtlas, vec3(uv, ndcDepth * 0.5 + 0.5));
+}
+
+PointLight FetchPointLight(int index)
+{
+    vec4 t0 = texelFetch(pointLightData, 4 * index);
+    vec4 t1 = texelFetch(pointLightData, 4 * index + 1);
+    vec4 t2 = texelFetch(pointLightData, 4 * index + 2);
+    vec4 t3 = texelFetch(pointLightData, 4 * index + 3);
+    return PointLight(t0.xyz, t0.w, t1.xyz, t2.xyz, t3.xyz, t1.w, t2.w, t3.w);
 }
 
 // calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow)
 {
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
@@ -91,13 +181,16 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // faded out to exactly zero at the radius, beyond which the light isn't listed in the cluster
+    float window = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
     vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
     ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
+    diffuse *= attenuation * shadow;
+    specular *= attenuation * shadow;
     return (ambient + diffuse + specular);
 }
 
@@ -133,22 +226,26 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 void main()
 {
     vec3 norm = normalize(Normal);
-    vec3 viewDir = normalize(viewPosition - FragPos);
+    vec3 viewDir = normalize(viewPosition.xyz - FragPos);
+
+    float viewDepth = -(view * vec4(FragPos, 1.0)).z;
 
     //directional lighting
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    //point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+    float shadow = CalcShadow(FragPos, norm, normalize(-dirLight.direction), viewDepth);
+    vec3 result = CalcDirLight(dirLight, norm, viewDir, shadow);
+    //point lights, only those listed for this fragment's cluster
+    uint slice = uint(clamp(log(viewDepth) * clusterParams.x + clusterParams.y, 0.0, float(clusterGrid.z - 1u)));
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * clusterParams.zw), clusterGrid.xy - 1u);
+    uvec2 range = texelFetch(clusterLights, int(tile.x + clusterGrid.x * (tile.y + clusterGrid.y * slice))).xy;
+    for(uint i = 0u; i < range.y; i++) {
+        int index = int(texelFetch(lightIndices, int(range.x + i)).r);
+        PointLight light = FetchPointLight(index);
+        float shadow = CalcPointShadow(index, light.position, FragPos, norm);
+        result += CalcPointLight(light, norm, FragPos, viewDir, shadow);
+    }
     //spot light
     result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
 
-    // proverava da li je brightness vece od odredjene granice, ako jeste onda primenjuje bloom
-    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
-    if(brightness > 0.9)
-        BrightColor = vec4(result, 1.0);
-    else
-        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
-
+    // the bright parts for bloom are extracted later from the whole frame, see bright_pass.fs
     FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
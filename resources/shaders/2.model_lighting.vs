@@ -8,8 +8,15 @@ out vec3 Normal;
 out vec3 FragPos;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+};
+
+// must match depth_prepass.vs, whose depth the pre-pass mode tests against with GL_EQUAL
+invariant gl_Position;
 
 void main()
 {
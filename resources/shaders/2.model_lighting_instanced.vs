@@ -0,0 +1,27 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// per-instance model matrix, occupies locations 5-8
+layout (location = 5) in mat4 aInstanceModel;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+};
+
+// must match depth_prepass.vs, whose depth the pre-pass mode tests against with GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+    FragPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+    Normal = aNormal;
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
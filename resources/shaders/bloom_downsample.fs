@@ -0,0 +1,57 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D srcTexture;
+uniform bool karisAverage;  // weight the taps by 1 / (1 + luma), used on the first downsample only
+
+float karisWeight(vec3 c)
+{
+    return 1.0 / (1.0 + dot(c, vec3(0.2126, 0.7152, 0.0722)));
+}
+
+// 13 bilinear taps (Jimenez, "Next Generation Post Processing in Call of Duty: Advanced Warfare"):
+// five overlapping 2x2 boxes, weighted so the result doesn't alias or flicker as the image moves.
+//     a - b - c
+//     - j - k -
+//     d - e - f
+//     - l - m -
+//     g - h - i
+void main()
+{
+    vec2 t = 1.0 / textureSize(srcTexture, 0);
+
+    vec3 a = texture(srcTexture, TexCoords + vec2(-2.0 * t.x,  2.0 * t.y)).rgb;
+    vec3 b = texture(srcTexture, TexCoords + vec2( 0.0,        2.0 * t.y)).rgb;
+    vec3 c = texture(srcTexture, TexCoords + vec2( 2.0 * t.x,  2.0 * t.y)).rgb;
+    vec3 d = texture(srcTexture, TexCoords + vec2(-2.0 * t.x,  0.0)).rgb;
+    vec3 e = texture(srcTexture, TexCoords).rgb;
+    vec3 f = texture(srcTexture, TexCoords + vec2( 2.0 * t.x,  0.0)).rgb;
+    vec3 g = texture(srcTexture, TexCoords + vec2(-2.0 * t.x, -2.0 * t.y)).rgb;
+    vec3 h = texture(srcTexture, TexCoords + vec2( 0.0,       -2.0 * t.y)).rgb;
+    vec3 i = texture(srcTexture, TexCoords + vec2( 2.0 * t.x, -2.0 * t.y)).rgb;
+    vec3 j = texture(srcTexture, TexCoords + vec2(-t.x,  t.y)).rgb;
+    vec3 k = texture(srcTexture, TexCoords + vec2( t.x,  t.y)).rgb;
+    vec3 l = texture(srcTexture, TexCoords + vec2(-t.x, -t.y)).rgb;
+    vec3 m = texture(srcTexture, TexCoords + vec2( t.x, -t.y)).rgb;
+
+    // the four corner boxes get 0.125 each, the center box 0.5
+    vec3 boxes[5] = vec3[](
+        (a + b + d + e) * 0.25,
+        (b + c + e + f) * 0.25,
+        (d + e + g + h) * 0.25,
+        (e + f + h + i) * 0.25,
+        (j + k + l + m) * 0.25
+    );
+    float weights[5] = float[](0.125, 0.125, 0.125, 0.125, 0.5);
+
+    vec3 result = vec3(0.0);
+    float total = 0.0;
+    for (int n = 0; n < 5; n++) {
+        float w = weights[n] * (karisAverage ? karisWeight(boxes[n]) : 1.0);
+        result += boxes[n] * w;
+        total += w;
+    }
+    FragColor = vec4(result / total, 1.0);
+}
@@ -7,6 +7,7 @@ uniform sampler2D scene;
 uniform sampler2D bloomBlur;
 uniform bool bloom;
 uniform float exposure;
+uniform float bloomIntensity;   // scales bloomBlur, which may be the sum of several blur levels
 
 void main()
 {
@@ -14,7 +15,7 @@ void main()
     vec3 hdrColor = texture(scene, TexCoords).rgb;
     vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
     if(bloom){
-        hdrColor += bloomColor;
+        hdrColor += bloomColor * bloomIntensity;
         vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
         result = pow(result, vec3(1.0 / gamma));
         FragColor = vec4(result, 1.0);
@@ -0,0 +1,32 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D srcTexture;
+uniform float filterRadius;  // in texture coordinates
+
+// 3x3 tent filter; blended additively onto the next larger mip
+//     1 2 1
+//     2 4 2  / 16
+//     1 2 1
+void main()
+{
+    float x = filterRadius;
+    float y = filterRadius;
+
+    vec3 a = texture(srcTexture, vec2(TexCoords.x - x, TexCoords.y + y)).rgb;
+    vec3 b = texture(srcTexture, vec2(TexCoords.x,     TexCoords.y + y)).rgb;
+    vec3 c = texture(srcTexture, vec2(TexCoords.x + x, TexCoords.y + y)).rgb;
+    vec3 d = texture(srcTexture, vec2(TexCoords.x - x, TexCoords.y)).rgb;
+    vec3 e = texture(srcTexture, vec2(TexCoords.x,     TexCoords.y)).rgb;
+    vec3 f = texture(srcTexture, vec2(TexCoords.x + x, TexCoords.y)).rgb;
+    vec3 g = texture(srcTexture, vec2(TexCoords.x - x, TexCoords.y - y)).rgb;
+    vec3 h = texture(srcTexture, vec2(TexCoords.x,     TexCoords.y - y)).rgb;
+    vec3 i = texture(srcTexture, vec2(TexCoords.x + x, TexCoords.y - y)).rgb;
+
+    vec3 result = e * 4.0;
+    result += (b + d + f + h) * 2.0;
+    result += (a + c + g + i);
+    FragColor = vec4(result * (1.0 / 16.0), 1.0);
+}
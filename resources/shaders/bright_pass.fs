@@ -0,0 +1,21 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+uniform float threshold;
+uniform float knee;
+
+void main()
+{
+    // rendered at a lower resolution than scene, so this bilinear fetch averages the texels the pixel covers
+    vec3 color = texture(scene, TexCoords).rgb;
+
+    // soft knee: a quadratic ramp over [threshold - knee, threshold + knee], linear above it
+    float brightness = max(color.r, max(color.g, color.b));
+    float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+    soft = soft * soft / (4.0 * knee + 0.00001);
+    float contribution = max(soft, brightness - threshold) / max(brightness, 0.00001);
+    FragColor = vec4(color * contribution, 1.0);
+}
@@ -0,0 +1,121 @@
+#version 330 core
+out vec4 FragColor;
+
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+
+    float cutOff;
+    float outerCutOff;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+};
+
+struct DirLight{
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+in vec2 TexCoords;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+};
+
+layout (std140) uniform LightData {
+    DirLight dirLight;
+    SpotLight spotLight;
+};
+
+// cascaded shadow maps of dirLight, see CascadedShadowMaps
+layout (std140) uniform ShadowData {
+    mat4 lightSpace[4];
+    vec4 cascadeSplits;     // view depth where each cascade ends
+    vec4 cascadeTexels;     // world size of a shadow map texel
+    vec4 shadowParams;      // cascade count (0 = off), 1 / resolution, PCF radius in texels, depth bias
+};
+uniform sampler2DArrayShadow shadowMap;
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+uniform float shininess;
+
+// fraction of dirLight reaching fragPos, PCF filtered in the cascade that covers viewDepth
+float CalcShadow(vec3 fragPos, vec3 normal, vec3 lightDir, float viewDepth)
+{
+    int cascadeCount = int(shadowParams.x);
+    if (cascadeCount == 0 || viewDepth > cascadeSplits[cascadeCount - 1])
+        return 1.0;
+    int cascade = 0;
+    while (cascade < cascadeCount - 1 && viewDepth > cascadeSplits[cascade])
+        cascade++;
+    // looking up a point pushed out along the normal keeps surfaces from shadowing themselves at grazing angles
+    float grazing = 1.0 - max(dot(normal, lightDir), 0.0);
+    vec3 position = fragPos + normal * cascadeTexels[cascade] * (0.5 + grazing);
+    vec3 coords = (lightSpace[cascade] * vec4(position, 1.0)).xyz * 0.5 + 0.5;
+    float reference = coords.z - shadowParams.w;
+    int radius = int(shadowParams.z);
+    float lit = 0.0;
+    for (int x = -radius; x <= radius; x++)
+        for (int y = -radius; y <= radius; y++)
+            lit += texture(shadowMap, vec4(coords.xy + vec2(x, y) * shadowParams.y, float(cascade), reference));
+    return lit / float((2 * radius + 1) * (2 * radius + 1));
+}
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, float shadow)
+{
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+    return light.ambient * albedo + (light.diffuse * diff * albedo + light.specular * spec * albedo) * shadow;
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularMap)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 halfwayDir = normalize(viewDir + lightDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    return (light.ambient * albedo + light.diffuse * diff * albedo + light.specular * spec * specularMap) * intensity;
+}
+
+// Full-screen pass of the deferred path: the lights of LightData, with the same equations as
+// 2.model_lighting.fs, evaluated once per pixel instead of once per drawn fragment. Point lights are
+// drawn afterwards as volumes, see deferred_point.fs
+void main()
+{
+    float depth = texture(gDepth, TexCoords).r;
+    // nothing was drawn here, the skybox fills it later
+    if (depth == 1.0)
+        discard;
+    vec4 position = inverseViewProjection * vec4(vec3(TexCoords, depth) * 2.0 - 1.0, 1.0);
+    vec3 fragPos = position.xyz / position.w;
+    vec4 albedoSpec = texture(gAlbedoSpec, TexCoords);
+    vec3 norm = texture(gNormal, TexCoords).xyz;
+    vec3 viewDir = normalize(viewPosition.xyz - fragPos);
+
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    float shadow = CalcShadow(fragPos, norm, normalize(-dirLight.direction), viewDepth);
+    vec3 result = CalcDirLight(dirLight, norm, viewDir, albedoSpec.rgb, shadow);
+    result += CalcSpotLight(spotLight, norm, fragPos, viewDir, albedoSpec.rgb, albedoSpec.a);
+    FragColor = vec4(result, 1.0);
+}
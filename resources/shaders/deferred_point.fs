@@ -0,0 +1,92 @@
+#version 330 core
+out vec4 FragColor;
+
+flat in vec4 PositionRadius;
+flat in vec4 AmbientConstant;
+flat in vec4 DiffuseLinear;
+flat in vec4 SpecularQuadratic;
+flat in int LightIndex;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+};
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+uniform vec2 inverseScreenSize;
+uniform float shininess;
+// point light shadows, see PointShadowAtlas
+uniform samplerBuffer pointShadowInfo;
+uniform sampler2DShadow pointShadowAtlas;
+
+// fraction of a point light reaching fragPos, from its tiles in the shadow atlas (see PointShadowAtlas)
+const vec3 faceDirections[6] = vec3[](vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0),
+                                      vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+const vec3 faceUps[6] = vec3[](vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0),
+                               vec3(0.0, 0.0, -1.0), vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0));
+
+float CalcPointShadow(int index, vec3 lightPosition, vec3 fragPos, vec3 normal)
+{
+    vec4 block = texelFetch(pointShadowInfo, 2 * index);
+    if (block.x < 0.0)
+        return 1.0;
+    vec4 params = texelFetch(pointShadowInfo, 2 * index + 1);
+    float nearPlane = params.x;
+    float farPlane = block.w;
+    vec3 toFrag = fragPos - lightPosition;
+    // pushed out along the normal by about a texel at this distance
+    toFrag += normal * (2.0 * params.y * length(toFrag));
+    vec3 a = abs(toFrag);
+    int face = a.x >= a.y && a.x >= a.z ? (toFrag.x > 0.0 ? 0 : 1)
+             : a.y >= a.z ? (toFrag.y > 0.0 ? 2 : 3) : (toFrag.z > 0.0 ? 4 : 5);
+    // the face's view space, as glm::lookAt builds it
+    vec3 forward = faceDirections[face];
+    vec3 right = normalize(cross(forward, faceUps[face]));
+    vec3 up = cross(right, forward);
+    float depth = dot(toFrag, forward);
+    vec2 ndc = vec2(dot(toFrag, right), dot(toFrag, up)) / depth;
+    float ndcDepth = (farPlane + nearPlane) / (farPlane - nearPlane) - 2.0 * farPlane * nearPlane / ((farPlane - nearPlane) * depth);
+    // stay half a texel inside the tile, so filtering never reads the neighbouring face
+    vec2 tileUv = clamp(ndc * 0.5 + 0.5, 0.5 * params.y, 1.0 - 0.5 * params.y);
+    vec2 uv = block.xy + (vec2(face % 3, face / 3) + tileUv) * block.z;
+    return texture(pointShadowAtlas, vec3(uv, ndcDepth * 0.5 + 0.5));
+}
+
+// One point light of the deferred path, drawn as a volume and added onto the HDR target.
+// Only pixels the volume covers run this, so a light costs in proportion to its size on screen.
+// The lighting is CalcPointLight of 2.model_lighting.fs
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    if (depth == 1.0)
+        discard;
+    vec2 uv = gl_FragCoord.xy * inverseScreenSize;
+    vec4 position = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec3 fragPos = position.xyz / position.w;
+
+    vec3 toLight = PositionRadius.xyz - fragPos;
+    float distance = length(toLight);
+    float radius = PositionRadius.w;
+    if (distance >= radius)
+        discard;
+    float attenuation = 1.0 / (AmbientConstant.w + DiffuseLinear.w * distance + SpecularQuadratic.w * (distance * distance));
+    // faded out to exactly zero at the radius, so the volume's edge can't be seen
+    float window = clamp(1.0 - pow(distance / radius, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
+
+    vec4 albedoSpec = texelFetch(gAlbedoSpec, pixel, 0);
+    vec3 normal = texelFetch(gNormal, pixel, 0).xyz;
+    vec3 lightDir = toLight / distance;
+    vec3 viewDir = normalize(viewPosition.xyz - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float spec = pow(max(dot(normal, normalize(viewDir + lightDir)), 0.0), shininess);
+    float shadow = CalcPointShadow(LightIndex, PositionRadius.xyz, fragPos, normal);
+    vec3 result = AmbientConstant.rgb * albedoSpec.rgb
+                  + (DiffuseLinear.rgb * diff * albedoSpec.rgb + SpecularQuadratic.rgb * spec * albedoSpec.a) * shadow;
+    FragColor = vec4(result * attenuation, 1.0);
+}
@@ -0,0 +1,30 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+// per-instance light, a PointLightSource
+layout (location = 1) in vec4 aPositionRadius;
+layout (location = 2) in vec4 aAmbientConstant;
+layout (location = 3) in vec4 aDiffuseLinear;
+layout (location = 4) in vec4 aSpecularQuadratic;
+
+flat out vec4 PositionRadius;
+flat out vec4 AmbientConstant;
+flat out vec4 DiffuseLinear;
+flat out vec4 SpecularQuadratic;
+flat out int LightIndex;    // into pointShadowInfo
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+};
+
+// aPos is a sphere enclosing the unit sphere, scaled here to the light's radius
+void main()
+{
+    PositionRadius = aPositionRadius;
+    AmbientConstant = aAmbientConstant;
+    DiffuseLinear = aDiffuseLinear;
+    SpecularQuadratic = aSpecularQuadratic;
+    LightIndex = gl_InstanceID;
+    gl_Position = projection * view * vec4(aPositionRadius.xyz + aPos * aPositionRadius.w, 1.0);
+}
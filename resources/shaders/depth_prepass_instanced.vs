@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+// per-instance model matrix, occupies locations 5-8
+layout (location = 5) in mat4 aInstanceModel;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+};
+
+// the shading pass tests against this depth with GL_EQUAL, so both must compute gl_Position identically
+invariant gl_Position;
+
+void main()
+{
+    vec3 FragPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormal;
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+
+    float shininess;
+};
+
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+
+uniform Material material;
+
+// the deferred counterpart of 2.model_lighting.fs: stores what its lighting reads, deferred_*.fs light it
+void main()
+{
+    gAlbedoSpec.rgb = texture(material.texture_diffuse1, TexCoords).rgb;
+    gAlbedoSpec.a = texture(material.texture_specular1, TexCoords).r;
+    gNormal = vec4(normalize(Normal), 0.0);
+}
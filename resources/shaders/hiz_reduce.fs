@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) out float Depth;
+
+uniform sampler2D source;   // the scene depth or the previous pyramid level, made its base level
+uniform ivec2 sourceSize;
+
+// One level of the depth pyramid of HiZOcclusion: every texel keeps the farthest depth of the source
+// texels below it. A level is half its source rounded down, so for an odd source size the texels also
+// take the next row or column; that way every texel covers its share of the screen completely.
+void main()
+{
+    ivec2 base = ivec2(gl_FragCoord.xy) * 2;
+    ivec2 extent = ivec2(2) + (sourceSize & 1);
+    float depth = 0.0;
+    for (int y = 0; y < extent.y; y++)
+        for (int x = 0; x < extent.x; x++)
+            depth = max(depth, texelFetch(source, min(base + ivec2(x, y), sourceSize - 1), 0).r);
+    Depth = depth;
+}
@@ -5,8 +5,12 @@ layout (location = 1) in vec2 aTexCoords;
 out vec2 TexCoords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+};
 
 void main()
 {
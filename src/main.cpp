@@ -13,6 +13,23 @@
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/uniform_buffer.h>
+#include <learnopengl/scene.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/benchmark.h>
+#include <learnopengl/camera_path.h>
+#include <learnopengl/fullscreen_quad.h>
+#include <learnopengl/bloom.h>
+#include <learnopengl/bright_pass.h>
+#include <learnopengl/gaussian_kernel.h>
+#include <learnopengl/compute_blur.h>
+#include <learnopengl/render_targets.h>
+#include <learnopengl/dynamic_resolution.h>
+#include <learnopengl/deferred.h>
+#include <learnopengl/clustered_lights.h>
+#include <learnopengl/cascaded_shadows.h>
+#include <learnopengl/point_shadows.h>
+#include <learnopengl/hiz_occlusion.h>
 
 #include <iostream>
 
@@ -28,16 +45,63 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 
 unsigned int loadTexture(const char *path);
 unsigned int loadCubemap(vector<std::string> faces);
-
-void renderQuad();
+void placeLanterns(std::vector<PointLightSource> &lights, unsigned int count);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+const unsigned int BLOOM_DOWNSCALE = 2;    // the bright pass and Gaussian blur run at 1/2 resolution per axis
+const float RENDER_SCALE_MIN = 0.5f;
+const float RENDER_SCALE_MAX = 2.0f;
+// clip planes of the camera projection; everything fitted to the view frustum takes them from here
+const float CAMERA_NEAR = 0.1f;
+const float CAMERA_FAR = 100.0f;
+// size of the default framebuffer, kept up to date by framebuffer_size_callback (differs from the window size on HiDPI screens)
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
+float renderScale = 1.0f;   // the scene renders at renderScale * framebuffer size per axis, bloom_final rescales it to the window
 bool spotlightOn = false;
 bool bloom = true;
 bool bloomKeyPressed = false;
 float exposure = 1.0f;
+enum BloomMode {
+    BLOOM_MIP_CHAIN = 0,    // BloomMipChain, wide glow at a fraction of the fill rate
+    BLOOM_GAUSSIAN  = 1     // the original full resolution ping-pong blur
+};
+int bloomMode = BLOOM_MIP_CHAIN;
+float bloomFilterRadius = 0.005f;
+float bloomThreshold = 0.9f;    // see BrightPass
+float bloomKnee = 0.5f;
+bool computeBlurAvailable = false;  // GL 4.3 context, see GLCompute
+bool useComputeBlur = true;
+float blurSigma = 1.75f;    // of the Gaussian bloom, in texels; close to the kernel blur.fs used to hard-code
+enum ShadingPath {
+    SHADING_FORWARD  = 0,   // 2.model_lighting.fs, every fragment evaluates the point lights of its cluster
+    SHADING_DEFERRED = 1    // DeferredRenderer, point lights drawn as light volumes
+};
+int shadingPath = SHADING_FORWARD;
+const int LANTERN_COUNT = 256;
+int lanternsShown = 0;  // the lanterns are the benchmark's light load; all of them with --bench, else from the UI
+unsigned int clusterLightIndices = 0;   // of the last ClusteredLights::Build, for the UI
+unsigned int clusterMaxLights = 0;
+bool depthPrepass = false;  // scene depth first, so the shading pass runs its fragment shaders once per pixel
+bool shadowsEnabled = true;
+int shadowCascades = 4;
+int shadowResolution = 2048;    // of every cascade
+float shadowDistance = 100.0f;  // clamped to CAMERA_FAR by CascadedShadowMaps::Update
+float shadowSplitLambda = 0.75f;
+bool shadowCache = true;    // static casters rendered once, see CascadedShadowMaps
+unsigned int shadowStaticBakes = 0;
+bool pointShadowsEnabled = true;
+int pointShadowBudget = 4;  // point lights whose shadows are re-rendered per frame, see PointShadowAtlas
+unsigned int pointShadowsShown = 0;
+unsigned int pointShadowsRefreshed = 0;
+unsigned int shadowCasterDraws = 0;
+bool occlusionCulling = true;   // meshes hidden behind the depth of earlier frames are skipped, see HiZOcclusion
+unsigned int occlusionTested = 0;
+unsigned int occlusionCulled = 0;
+float lodPixelError = 1.0f;     // screen space error a mesh LOD may have, 0 draws full detail; see Scene::SetLodProjection
+unsigned int sceneTriangles = 0;
 
 // camera
 
@@ -126,29 +190,51 @@ void ProgramState::LoadFromFile(std::string filename) {
 }
 
 ProgramState *programState;
+Profiler profiler;
+DynamicResolution dynamicResolution;
 
 void DrawImGui(ProgramState *programState);
 
-int main() {
+int main(int argc, char **argv) {
+    // --bench renders a recorded camera flight in a hidden window and reports frame time percentiles
+    BenchOptions bench;
+    if (!ParseBenchOptions(argc, argv, bench))
+        return -1;
+    CameraPath benchPath;
+    if (bench.enabled && !benchPath.LoadFromFile(bench.cameraPath))
+        return -1;
+
     // glfw: initialize and configure
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    // ask for GL 4.3 (compute shaders) first; everything else only needs 3.3
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+    if (bench.enabled)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     // glfw window creation
     GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+    if (window == NULL) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+    }
     if (window == NULL) {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
         return -1;
     }
     glfwMakeContextCurrent(window);
+    // frames must not wait for the display while benchmarking
+    if (bench.enabled)
+        glfwSwapInterval(0);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetKeyCallback(window, key_callback);
@@ -160,9 +246,12 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    computeBlurAvailable = GLCompute::Load((GLADloadproc) glfwGetProcAddress);
 
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
+    if (bench.enabled)
+        programState->ImGuiEnabled = false;
     if (programState->ImGuiEnabled) {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
@@ -190,86 +279,50 @@ int main() {
 
     // build and compile shaders
     Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
+    Shader ourInstancedShader("resources/shaders/2.model_lighting_instanced.vs", "resources/shaders/2.model_lighting.fs");
     Shader skyboxShader("resources/shaders/6.1.skybox.vs", "resources/shaders/6.1.skybox.fs");
     Shader transpShader("resources/shaders/transparentobj.vs", "resources/shaders/transparentobj.fs");
     Shader shaderBlur("resources/shaders/blur.vs", "resources/shaders/blur.fs");
     Shader shaderBloomFinal("resources/shaders/bloom_final.vs", "resources/shaders/bloom_final.fs");
     Shader cubeShader("resources/shaders/cube.vs", "resources/shaders/cube.fs");
     Shader lightCubeShader("resources/shaders/lightCubeShader.vs", "resources/shaders/lightCubeShader.fs");
-
-    // load models
-    Model ourModelOgrada("resources/objects/ograda/13080_Wrought_Iron_fence_with_brick_v1_L2.obj", true);
-    ourModelOgrada.SetShaderTextureNamePrefix("material.");
-
-    Model ourModelKocije("resources/objects/kocije/13915_Horse_and_Carriage_v1_l3.obj", true);
-    ourModelKocije.SetShaderTextureNamePrefix("material.");
-
-    Model ourModelHouse("resources/objects/kuca/Farmhouse Maya 2016 Updated/farmhouse_obj.obj", true);
-    ourModelHouse.SetShaderTextureNamePrefix("material.");
-
-    Model ourModeltrava("resources/objects/trava/10450_Rectangular_Grass_Patch_v1_iterations-2.obj", true);
-    ourModeltrava.SetShaderTextureNamePrefix("material.");
-
-    Model ourModelDrvena("resources/objects/Gothic_Wood_Picket_Fence_Panel_v1_L3.123c0a8b2f5-63a6-492b-921a-25a88a08d240/13077_Gothic_Picket_Fence_Panel_v3_l3.obj", true);
-    ourModelDrvena.SetShaderTextureNamePrefix("material.");
-
-    Model ourModelPauk("resources/objects/Bumblebee_L3.123c7693bf01-7e49-4479-a0b7-5e9659e7fdd9/10006_Bumblebee_v1_L3.obj", true);
-    ourModelPauk.SetShaderTextureNamePrefix("material.");
+    Shader gbufferShader("resources/shaders/2.model_lighting.vs", "resources/shaders/gbuffer.fs");
+    Shader gbufferInstancedShader("resources/shaders/2.model_lighting_instanced.vs", "resources/shaders/gbuffer.fs");
+    Shader depthShader("resources/shaders/depth_prepass.vs", "resources/shaders/depth_prepass.fs");
+    Shader depthInstancedShader("resources/shaders/depth_prepass_instanced.vs", "resources/shaders/depth_prepass.fs");
+
+    // load models and their placements
+    Scene scene;
+    scene.AddPass("lit", ourShader, ourInstancedShader);
+    scene.AddPassVariant("lit", SHADER_GBUFFER, gbufferShader, gbufferInstancedShader);
+    scene.AddPassVariant("lit", SHADER_DEPTH, depthShader, depthInstancedShader);
+    scene.LoadFromFile("resources/scene.txt");
+    int paukNode = scene.Find("pauk");
+    RenderQueue renderQueue;
+    // the pre-pass has no state worth grouping by, so it draws nearest first for the most early depth rejects
+    RenderQueue depthQueue;
+    depthQueue.order = SORT_FRONT_TO_BACK;
 
     //Bloom efekat _____________________________________________________________________________________________
-    // configure framebuffers
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-    // create 2 color buffers (1 for normal rendering, other for brightness threshold values)
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);  // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        // attach texture to framebuffer
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
-    }
-    // create and attach depth buffer (renderbuffer)
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorBuffers[0], 0);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-
-    // check if framebuffer is complete
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // ping-pong-framebuffer for blurring
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
+    // the HDR frame, the bright pass and the blur targets are taken from the pool each frame at the current
+    // window size and render scale, so resizing the window or changing the scale just asks for other sizes
+    RenderTargetPool renderTargets;
+    if (bench.enabled) {
+        renderScale = bench.renderScale;
+        dynamicResolution.enabled = bench.gpuBudgetMs > 0.0f;
+        dynamicResolution.budgetMs = bench.gpuBudgetMs;
+        if (bench.deferred)
+            shadingPath = SHADING_DEFERRED;
+        depthPrepass = bench.depthPrepass;
+        lanternsShown = LANTERN_COUNT;
+        shadowsEnabled = bench.shadowCascades > 0;
+        shadowCascades = std::max(bench.shadowCascades, 1);
+        shadowResolution = bench.shadowResolution;
+        shadowCache = bench.shadowCache;
+        pointShadowsEnabled = bench.pointShadowBudget > 0;
+        pointShadowBudget = std::max(bench.pointShadowBudget, 1);
+        occlusionCulling = bench.occlusionCulling;
+        lodPixelError = bench.lodPixelError;
     }
 
     // setting coordinates:
@@ -400,6 +453,9 @@ int main() {
     // _______________________________________________________________________________________________
     ourShader.use();
     ourShader.setInt("diffuseTexture", 0);
+    ourShader.setFloat("material.shininess", 32.0f);
+    ourInstancedShader.use();
+    ourInstancedShader.setFloat("material.shininess", 32.0f);
     transpShader.use();
     transpShader.setInt("texture1", 0);
     shaderBlur.use();
@@ -408,227 +464,277 @@ int main() {
     shaderBloomFinal.setInt("scene", 0);
     shaderBloomFinal.setInt("bloomBlur", 1);
 
+    // per-frame camera and light data shared by all scene shaders
+    UniformBuffer<FrameData> frameUbo(FRAME_DATA_BINDING);
+    UniformBuffer<LightData> lightUbo(LIGHT_DATA_BINDING);
+    ourShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    ourShader.bindUniformBlock("LightData", LIGHT_DATA_BINDING);
+    ourInstancedShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    ourInstancedShader.bindUniformBlock("LightData", LIGHT_DATA_BINDING);
+    transpShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    gbufferShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    gbufferInstancedShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    depthShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    depthInstancedShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    skyboxShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+
+    // uniform handles used every frame
+    UniformHandle uTranspModel = transpShader.uniform("model");
+    UniformHandle uBlurHorizontal = shaderBlur.uniform("horizontal");
+    UniformHandle uBlurTapCount = shaderBlur.uniform("tapCount");
+    UniformHandle uBlurWeights = shaderBlur.uniform("weights");
+    UniformHandle uBlurOffsets = shaderBlur.uniform("offsets");
+    float uploadedBlurSigma = -1.0f;
+    UniformHandle uBloom = shaderBloomFinal.uniform("bloom");
+    UniformHandle uExposure = shaderBloomFinal.uniform("exposure");
+    UniformHandle uBloomIntensity = shaderBloomFinal.uniform("bloomIntensity");
+
+    BrightPass brightPass;
+    // the chain starts from the already downscaled bright pass; it is rebuilt in the loop when that changes size
+    BloomMipChain bloomChain(SCR_WIDTH / BLOOM_DOWNSCALE, SCR_HEIGHT / BLOOM_DOWNSCALE);
+    std::unique_ptr<ComputeBlur> computeBlur;
+    if (computeBlurAvailable)
+        computeBlur.reset(new ComputeBlur());
+
+    DeferredRenderer deferred;
+    ClusteredLights clusteredLights;
+    ClusteredLights::SetupShader(ourShader);
+    ClusteredLights::SetupShader(ourInstancedShader);
+    CascadedShadowMaps shadows;
+    CascadedShadowMaps::SetupShader(ourShader);
+    CascadedShadowMaps::SetupShader(ourInstancedShader);
+    RenderQueue shadowQueue;
+    // 4096^2 in 256^2 tiles holds the cube faces of 40 lights
+    PointShadowAtlas pointShadows;
+    pointShadows.Resize(4096, 256);
+    PointShadowAtlas::SetupShader(ourShader);
+    PointShadowAtlas::SetupShader(ourInstancedShader);
+    // every point light of the frame: the two of ProgramState, then the lanterns
+    std::vector<PointLightSource> lanterns;
+    placeLanterns(lanterns, LANTERN_COUNT);
+    std::vector<PointLightSource> pointLights;
+    HiZOcclusion hiz;
+
+    // the vegetation quad never moves, its model matrix is built once
+    glm::mat4 vegetationModel = glm::mat4(1.0f);
+    vegetationModel = glm::translate(vegetationModel, glm::vec3(-50.8f, 3.566f, 35.0f));
+    vegetationModel = glm::rotate(vegetationModel,glm::radians(9.0f),glm::vec3(1.0f,0.0f,0.0f));
+    vegetationModel = glm::rotate(vegetationModel,glm::radians(-100.0f),glm::vec3(0.0f,1.0f,0.0f));
+    vegetationModel = glm::rotate(vegetationModel,glm::radians(16.0f),glm::vec3(0.0f,0.0f,1.0f));
+    vegetationModel = glm::scale(vegetationModel, glm::vec3(3.5f));
+
+    // the benchmark measures rendering, not image decoding
+    BenchRecorder benchRecorder;
+    unsigned int benchFrame = 0;
+    unsigned int benchGpuFrames = 0;
+    unsigned int scaledGpuFrames = 0;   // GPU frame times already given to dynamicResolution
+    double benchLastFrameEnd = 0.0;
+    if (bench.enabled)
+        TextureLoader::Instance().Finish();
+
     // render loop
     while (!glfwWindowShouldClose(window)) {
-        // per-frame time logic
-        float currentFrame = glfwGetTime();
+        // per-frame time logic; the benchmark advances a fixed step per frame so every run renders the same images
+        float currentFrame = bench.enabled ? benchFrame * bench.timestep : glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        profiler.BeginFrame();
+
         // input
-        processInput(window);
+        if (bench.enabled) {
+            CameraKeyframe pose = benchPath.Evaluate(std::fmod(currentFrame, benchPath.Duration()));
+            programState->camera.SetPose(pose.position, pose.yaw, pose.pitch);
+        } else
+            processInput(window);
+
+        // textures whose decode finished on the loader threads
+        TextureLoader::Instance().ProcessUploads();
 
 
         // render
         glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        // GPU times arrive a few frames late, each one is used once
+        if (dynamicResolution.enabled && profiler.gpuFramesResolved != scaledGpuFrames)
+            renderScale = dynamicResolution.Update(renderScale, profiler.GpuFrameMs());
+        scaledGpuFrames = profiler.gpuFramesResolved;
+
+        // sizes of this frame's render targets; a minimized window has a 0x0 framebuffer
+        renderScale = glm::clamp(renderScale, RENDER_SCALE_MIN, RENDER_SCALE_MAX);
+        int renderWidth = std::max(1, (int) (framebufferWidth * renderScale));
+        int renderHeight = std::max(1, (int) (framebufferHeight * renderScale));
+        int brightWidth = std::max(1, renderWidth / (int) BLOOM_DOWNSCALE);
+        int brightHeight = std::max(1, renderHeight / (int) BLOOM_DOWNSCALE);
+
         //render scene into floating point framebuffer
         // ____________________________________________________________________________________
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+        RenderTarget &hdrTarget = renderTargets.Acquire(renderWidth, renderHeight, GL_RGBA16F, true);
+        glBindFramebuffer(GL_FRAMEBUFFER, hdrTarget.framebuffer);
+        glViewport(0, 0, renderWidth, renderHeight);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // enable shader before setting uniforms
-        ourShader.use();
-
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom), (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = programState->camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
-
-
-        // directional light glm::vec3(-2.32,0.54,5.87)
-//        ourShader.setVec3("dirLight.direction", glm::vec3(3.0f, 3.0f, -5.0f));
-//        ourShader.setVec3("dirLight.ambient", glm::vec3(0.3f));
-//        ourShader.setVec3("dirLight.diffuse", glm::vec3(0.4f));
-//        ourShader.setVec3("dirLight.specular", glm::vec3(0.5f));
-
-        ourShader.setVec3("dirLight.direction", programState->dirLightDir);
-        ourShader.setVec3("dirLight.ambient", glm::vec3(programState->dirLightAmbDiffSpec.x));
-        ourShader.setVec3("dirLight.diffuse", glm::vec3(programState->dirLightAmbDiffSpec.y));
-        ourShader.setVec3("dirLight.specular", glm::vec3(programState->dirLightAmbDiffSpec.z));
-
-        ourShader.setVec3("pointLights[0].position", glm::vec3(-0.8f ,0.05f, 2.7f));
-        ourShader.setVec3("pointLights[0].ambient", pointLight.ambient);
-        ourShader.setVec3("pointLights[0].diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLights[0].specular", pointLight.specular);
-        ourShader.setFloat("pointLights[0].constant", pointLight.constant);
-        ourShader.setFloat("pointLights[0].linear", pointLight.linear);
-        ourShader.setFloat("pointLights[0].quadratic", pointLight.quadratic);
-
-        ourShader.setVec3("pointLights[1].position", glm::vec3(-1.2f ,0.3f, -0.05f));
-        ourShader.setVec3("pointLights[1].ambient", pointLight.ambient);
-        ourShader.setVec3("pointLights[1].diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLights[1].specular", pointLight.specular);
-        ourShader.setFloat("pointLights[1].constant", pointLight.constant);
-        ourShader.setFloat("pointLights[1].linear", pointLight.linear);
-        ourShader.setFloat("pointLights[1].quadratic", pointLight.quadratic);
+        // camera and lights go to the GPU once per frame, for every shader
+        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom), (float) renderWidth / (float) renderHeight, CAMERA_NEAR, CAMERA_FAR);
+        FrameData frameData;
+        frameData.projection = projection;
+        frameData.view = programState->camera.GetViewMatrix();
+        frameData.viewPosition = glm::vec4(programState->camera.Position, 1.0f);
+        frameUbo.update(frameData);
+
+        LightData lightData;
+        lightData.dirLight.direction = programState->dirLightDir;
+        lightData.dirLight.ambient = glm::vec3(programState->dirLightAmbDiffSpec.x);
+        lightData.dirLight.diffuse = glm::vec3(programState->dirLightAmbDiffSpec.y);
+        lightData.dirLight.specular = glm::vec3(programState->dirLightAmbDiffSpec.z);
+
+        const glm::vec3 pointLightPositions[] = {
+                glm::vec3(-0.8f ,0.05f, 2.7f),
+                glm::vec3(-1.2f ,0.3f, -0.05f)
+        };
+        pointLights.clear();
+        for (const glm::vec3 &position : pointLightPositions) {
+            PointLightSource light;
+            light.position = position;
+            light.ambient = pointLight.ambient;
+            light.diffuse = pointLight.diffuse;
+            light.specular = pointLight.specular;
+            light.constant = pointLight.constant;
+            light.linear = pointLight.linear;
+            light.quadratic = pointLight.quadratic;
+            light.radius = PointLightRadius(light);
+            pointLights.push_back(light);
+        }
+        pointLights.insert(pointLights.end(), lanterns.begin(), lanterns.begin() + lanternsShown);
 
         // spotLight
         //___________________________________________________________________________________________________
-        if (spotlightOn) {
-            ourShader.setVec3("spotLight.position", programState->camera.Position);
-            ourShader.setVec3("spotLight.direction", programState->camera.Front);
-            ourShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-            ourShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-            ourShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-            ourShader.setFloat("spotLight.constant", 1.0f);
-            ourShader.setFloat("spotLight.linear", 0.09);
-            ourShader.setFloat("spotLight.quadratic", 0.032);
-            ourShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-            ourShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
-        }else{
-            ourShader.setVec3("spotLight.diffuse", 0.0f, 0.0f, 0.0f);
-            ourShader.setVec3("spotLight.specular", 0.0f, 0.0f, 0.0f);
+        SpotLightStd140 &spotLight = lightData.spotLight;
+        spotLight.position = programState->camera.Position;
+        spotLight.direction = programState->camera.Front;
+        spotLight.ambient = glm::vec3(0.0f);
+        spotLight.diffuse = spotlightOn ? glm::vec3(1.0f) : glm::vec3(0.0f);
+        spotLight.specular = spotlightOn ? glm::vec3(1.0f) : glm::vec3(0.0f);
+        spotLight.constant = 1.0f;
+        spotLight.linear = 0.09f;
+        spotLight.quadratic = 0.032f;
+        spotLight.cutOff = glm::cos(glm::radians(12.5f));
+        spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+        lightUbo.update(lightData);
+
+        // only the bumblebee moves, every other node keeps its cached world matrix
+        if (paukNode != -1)
+            scene.SetTranslation(paukNode, glm::vec3(-73.0f, 5.0f + cos(currentFrame * 0.6), 48.3f));
+        scene.Update();
+        // the camera passes pick LODs by its pixel size; the shadow maps draw full detail
+        scene.SetLodProjection(glm::radians(programState->camera.Zoom), renderHeight);
+        scene.lodPixelError = lodPixelError;
+
+        shadows.shadowDistance = shadowDistance;
+        shadows.splitLambda = shadowSplitLambda;
+        shadows.cacheStatic = shadowCache;
+        if (shadows.resolution != shadowResolution || shadows.cascadeCount != shadowCascades)
+            shadows.Resize(shadowResolution, shadowCascades);
+        shadows.Update(frameData.view, glm::radians(programState->camera.Zoom), (float) renderWidth / (float) renderHeight,
+                       CAMERA_NEAR, CAMERA_FAR, programState->dirLightDir, shadowsEnabled);
+        if (shadowsEnabled) {
+            profiler.Begin("shadows");
+            shadows.Render(scene, shadowQueue, frameUbo, frameData);
+            shadowCasterDraws = shadows.casterDraws;
+            shadowStaticBakes = shadows.staticBakes;
+            profiler.End();
+        }
+        shadows.Bind();
+
+        profiler.Begin("point_shadows");
+        pointShadows.budget = pointShadowBudget;
+        pointShadows.Update(pointLights, Frustum::FromMatrix(projection * frameData.view), programState->camera.Position,
+                            scene, shadowQueue, frameUbo, frameData, pointShadowsEnabled);
+        pointShadowsShown = pointShadows.shadowedLights;
+        pointShadowsRefreshed = pointShadows.refreshedLights;
+        profiler.End();
+        pointShadows.Bind();
+        // the shadow passes left their own framebuffers bound
+        glBindFramebuffer(GL_FRAMEBUFFER, hdrTarget.framebuffer);
+        glViewport(0, 0, renderWidth, renderHeight);
+
+        profiler.Begin("scene");
+        // deferred: the scene goes into the G-buffer and is lit afterwards, the passes below draw on top of that
+        SceneShaderVariant sceneVariant = shadingPath == SHADING_DEFERRED ? SHADER_GBUFFER : SHADER_FORWARD;
+        if (shadingPath == SHADING_DEFERRED) {
+            if (deferred.width != renderWidth || deferred.height != renderHeight)
+                deferred.Resize(renderWidth, renderHeight);
+            deferred.BeginGeometry();
+        } else {
+            clusteredLights.Build(pointLights, frameData.view, glm::radians(programState->camera.Zoom),
+                                  (float) renderWidth / (float) renderHeight, CAMERA_NEAR, CAMERA_FAR, renderWidth, renderHeight);
+            clusteredLights.Bind();
+            clusterLightIndices = clusteredLights.indexCount;
+            clusterMaxLights = clusteredLights.maxClusterLights;
         }
+        Frustum frustum = Frustum::FromMatrix(projection * frameData.view);
+        // only the camera's passes are occlusion culled, the depth is what the camera saw
+        HiZOcclusion *occlusion = occlusionCulling ? &hiz : nullptr;
+        // the pre-pass is timed as part of "scene", as profiler passes can't nest
+        if (depthPrepass) {
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            depthQueue.Clear();
+            scene.Submit(depthQueue, frustum, programState->camera.Position, SHADER_DEPTH, NODES_ALL, occlusion);
+            depthQueue.Sort();
+            depthQueue.Execute(true);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            // only the fragment that won the pre-pass shades its pixel; the depth is already final
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+        }
+        // draws are sorted by shader, material and mesh so redundant binds can be skipped
+        renderQueue.Clear();
+        hiz.ResetStats();
+        scene.Submit(renderQueue, frustum, programState->camera.Position, sceneVariant, NODES_ALL, occlusion);
+        occlusionTested = hiz.tested;
+        occlusionCulled = hiz.occluded;
+        renderQueue.Sort();
+        renderQueue.Execute();
+        sceneTriangles = renderQueue.stats.triangles;
+        if (depthPrepass) {
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+        }
+        profiler.End();
 
+        if (shadingPath == SHADING_DEFERRED) {
+            profiler.Begin("lighting");
+            deferred.Light(hdrTarget, projection, frameData.view, pointLights);
+            profiler.End();
+        }
 
-        // rendering loaded models
-        glm::mat4 model = glm::mat4(1.0f);
-
-        ourShader.use();
-
-        //OGRADA
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-49.0, 2.19, 44.0));
-        model = glm::rotate(model, glm::radians(-91.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model,glm::radians(-89.0f),glm::vec3(0.0f,0.0f,1.0f));
-        model = glm::scale(model, glm::vec3(0.05));
-        ourShader.setMat4("model", model);
-        ourModelOgrada.Draw(ourShader);
-
-        //KOCIJE
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-66.0f,4.2f,39.0f));
-        model = glm::rotate(model, glm::radians(2431.0f) ,glm::vec3(1.0f,0.0f,0.0f));
-        model = glm::rotate(model,glm::radians(359.2f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::rotate(model,glm::radians(82.0f),glm::vec3(0.0f,0.0f,1.0f));
-        model = glm::scale(model, glm::vec3(0.02));
-        ourShader.setMat4("model", model);
-        ourModelKocije.Draw(ourShader);
-
-        //HOUSE
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-72.0f, 2.2f, 52.0f));
-        model = glm::rotate(model,glm::radians(-2.0f),glm::vec3(1.0f,0.0f,0.0f));
-        model = glm::rotate(model,glm::radians(2.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::rotate(model,glm::radians(0.0f),glm::vec3(0.0f,0.0f,1.0f));
-        model = glm::scale(model, glm::vec3(0.35));
-        ourShader.setMat4("model", model);
-        ourModelHouse.Draw(ourShader);
-
-        //TRAVA
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-63.0f, 1.0f, 45.0f));
-        model = glm::rotate(model,glm::radians(88.0f),glm::vec3(1.0f,0.0f,0.0f));
-        model = glm::rotate(model,glm::radians(181.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::rotate(model,glm::radians(-178.0f),glm::vec3(0.0f,0.0f,1.0f));
-        model = glm::scale(model, glm::vec3(0.13));
-        ourShader.setMat4("model", model);
-        ourModeltrava.Draw(ourShader);
-
-        //TRAVA1
-//        model = glm::mat4(1.0f);
-//        model = glm::translate(model, programState->translateVec);
-//        model = glm::rotate(model,glm::radians(programState->rotateVec.x),glm::vec3(1.0f,0.0f,0.0f));
-//        model = glm::rotate(model,glm::radians(programState->rotateVec.y),glm::vec3(0.0f,1.0f,0.0f));
-//        model = glm::rotate(model,glm::radians(programState->rotateVec.z),glm::vec3(0.0f,0.0f,1.0f));
-//        model = glm::scale(model, glm::vec3(programState->scaleVar));
-//        ourShader.setMat4("model", model);
-//        ourModeltrava.Draw(ourShader);
-
-        //DRVENA OGRADA
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-72.0f, 2.0f, 64.0f));
-        model = glm::rotate(model,glm::radians(-90.0f),glm::vec3(1.0f,0.0f,0.0f));
-        model = glm::rotate(model,glm::radians(0.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::rotate(model,glm::radians(2.0f),glm::vec3(0.0f,0.0f,1.0f));
-        model = glm::scale(model, glm::vec3(0.09));
-        ourShader.setMat4("model", model);
-        ourModelDrvena.Draw(ourShader);
-
-        //DRVENA OGRADA1
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-81.5f, 1.0f, 55.0f));
-        model = glm::rotate(model,glm::radians(89.0f),glm::vec3(1.0f,0.0f,0.0f));
-        model = glm::rotate(model,glm::radians(180.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::rotate(model,glm::radians(-88.0f),glm::vec3(0.0f,0.0f,1.0f));
-        model = glm::scale(model, glm::vec3(0.09f));
-        ourShader.setMat4("model", model);
-        ourModelDrvena.Draw(ourShader);
-
-        //DRVENA OGRADA2
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-82.0f, 1.0f, 37.0f));
-        model = glm::rotate(model,glm::radians(-92.0f),glm::vec3(1.0f,0.0f,0.0f));
-        model = glm::rotate(model,glm::radians(0.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::rotate(model,glm::radians(93.0f),glm::vec3(0.0f,0.0f,1.0f));
-        model = glm::scale(model, glm::vec3(0.08f));
-        ourShader.setMat4("model", model);
-        ourModelDrvena.Draw(ourShader);
-
-        //DRVENA OGRADA3
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-53.0f, 2.0f, 63.0f));
-        model = glm::rotate(model,glm::radians(-91.0f),glm::vec3(1.0f,0.0f,0.0f));
-        model = glm::rotate(model,glm::radians(-1.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::rotate(model,glm::radians(4.0f),glm::vec3(0.0f,0.0f,1.0f));
-        model = glm::scale(model, glm::vec3(0.09));
-        ourShader.setMat4("model", model);
-        ourModelDrvena.Draw(ourShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-46.0f, 2.5f, 57.0f));
-        model = glm::rotate(model,glm::radians(-91.0f),glm::vec3(1.0f,0.0f,0.0f));
-        model = glm::rotate(model,glm::radians(1.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::rotate(model,glm::radians(-66.0f),glm::vec3(0.0f,0.0f,1.0f));
-        model = glm::scale(model, glm::vec3(0.05f));
-        ourShader.setMat4("model", model);
-        ourModelDrvena.Draw(ourShader);
-
-        //PAUK
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-73.0f, 5.0f + cos(glfwGetTime() * 0.6), 48.3f));
-        model = glm::rotate(model,glm::radians(98.0f),glm::vec3(1.0f,0.0f,0.0f));
-        model = glm::rotate(model,glm::radians(-188.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::rotate(model,glm::radians(-29.0f),glm::vec3(0.0f,0.0f,1.0f));
-        model = glm::scale(model, glm::vec3(0.05f));
-        ourShader.setMat4("model", model);
-        ourModelPauk.Draw(ourShader);
+        // the opaque scene's depth is complete here; it culls the frames that follow
+        if (occlusionCulling) {
+            profiler.Begin("hiz");
+            hiz.Build(hdrTarget.depthTexture, renderWidth, renderHeight, projection * frameData.view);
+            profiler.End();
+            glBindFramebuffer(GL_FRAMEBUFFER, hdrTarget.framebuffer);
+            glViewport(0, 0, renderWidth, renderHeight);
+        } else {
+            hiz.Invalidate();
+        }
 
+        profiler.Begin("vegetation");
         transpShader.use();
-        glm::mat4 projection1 = glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view1 = programState->camera.GetViewMatrix();
-        glm::mat4 model1 = glm::mat4(1.0f);
-        transpShader.setMat4("projection", projection1);
-        transpShader.setMat4("view", view1);
 
         // vegetation
         glBindVertexArray(transparentVAO);
         glBindTexture(GL_TEXTURE_2D, transparentTexture);
 
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-50.8f, 3.566f, 35.0f));
-        model = glm::rotate(model,glm::radians(9.0f),glm::vec3(1.0f,0.0f,0.0f));
-        model = glm::rotate(model,glm::radians(-100.0f),glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::rotate(model,glm::radians(16.0f),glm::vec3(0.0f,0.0f,1.0f));
-        model = glm::scale(model, glm::vec3(3.5f));
-        transpShader.setMat4("model", model);
+        transpShader.setMat4(uTranspModel, vegetationModel);
         glDrawArrays(GL_TRIANGLES, 0, 6);
-
-
+        profiler.End();
 
         // drawing skybox as last
+        profiler.Begin("skybox");
         glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
         skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
 
         // skybox cube
         glBindVertexArray(skyboxVAO);
@@ -637,46 +743,127 @@ int main() {
         glDrawArrays(GL_TRIANGLES, 0, 36);
         glBindVertexArray(0);
         glDepthFunc(GL_LESS); // set depth function back to default
+        profiler.End();
 
-        if (programState->ImGuiEnabled)
-            DrawImGui(programState);
+        // extract the bright parts at reduced resolution
+        // _____________________________________________________________________________________
+        profiler.Begin("bright_pass");
+        brightPass.threshold = bloomThreshold;
+        brightPass.knee = bloomKnee;
+        RenderTarget &brightTarget = renderTargets.Acquire(brightWidth, brightHeight, GL_RGBA16F);
+        brightPass.Render(hdrTarget.texture, brightTarget);
+        unsigned int brightTexture = brightTarget.texture;
+        profiler.End();
 
         // blur bright fragments with two-pass Gaussian Blur
         // _____________________________________________________________________________________
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 5;
-        shaderBlur.use();
-        for (unsigned int i = 0; i < amount; i++)
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            shaderBlur.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
-            renderQuad();
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
+        profiler.Begin("blur");
+        unsigned int bloomTexture;
+        float bloomIntensity = 1.0f;
+        // the first blur pass is the last reader of the bright pass, so its target doubles as the second ping-pong buffer
+        RenderTarget *pingpong[2] = {&brightTarget, nullptr};
+        if (bloomMode == BLOOM_MIP_CHAIN) {
+            if (bloomChain.width != brightWidth || bloomChain.height != brightHeight)
+                bloomChain.Resize(brightWidth, brightHeight);
+            bloomChain.filterRadius = bloomFilterRadius;
+            bloomTexture = bloomChain.Render(brightTexture);
+            bloomIntensity = bloomChain.Intensity();
+        } else if (computeBlur && useComputeBlur) {
+            pingpong[1] = &renderTargets.Acquire(brightWidth, brightHeight, GL_RGBA16F);
+            const unsigned int pingpongTextures[2] = {pingpong[0]->texture, pingpong[1]->texture};
+            bloomTexture = computeBlur->Blur(brightTexture, pingpongTextures, brightWidth, brightHeight, 5, blurSigma);
+        } else {
+            pingpong[1] = &renderTargets.Acquire(brightWidth, brightHeight, GL_RGBA16F);
+            GLint viewport[4];
+            glGetIntegerv(GL_VIEWPORT, viewport);
+            glViewport(0, 0, brightWidth, brightHeight);
+            bool horizontal = true, first_iteration = true;
+            unsigned int amount = 5;
+            shaderBlur.use();
+            // the kernel only goes to the GPU when its size changes
+            if (blurSigma != uploadedBlurSigma) {
+                GaussianKernel kernel = GaussianKernel::Linear(blurSigma);
+                shaderBlur.setInt(uBlurTapCount, kernel.TapCount());
+                shaderBlur.setFloatArray(uBlurWeights, kernel.weights.data(), kernel.TapCount());
+                shaderBlur.setFloatArray(uBlurOffsets, kernel.offsets.data(), kernel.TapCount());
+                uploadedBlurSigma = blurSigma;
+            }
+            for (unsigned int i = 0; i < amount; i++)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, pingpong[horizontal]->framebuffer);
+                shaderBlur.setInt(uBlurHorizontal, horizontal);
+                glBindTexture(GL_TEXTURE_2D, first_iteration ? brightTexture : pingpong[!horizontal]->texture);  // bind texture of other framebuffer (or bright pass if first iteration)
+                renderQuad();
+                horizontal = !horizontal;
+                if (first_iteration)
+                    first_iteration = false;
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+            bloomTexture = pingpong[!horizontal]->texture;
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        profiler.End();
 
         // now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
+        // at window resolution; the bilinear fetches scale the frame from the render scale up (or down) to it
         //____________________________________________________________________________________________________
+        profiler.Begin("bloom_final");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, framebufferWidth, framebufferHeight);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         shaderBloomFinal.use();
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
+        glBindTexture(GL_TEXTURE_2D, hdrTarget.texture);
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        shaderBloomFinal.setInt("bloom", bloom);
-        shaderBloomFinal.setFloat("exposure", exposure);
+        glBindTexture(GL_TEXTURE_2D, bloomTexture);
+        shaderBloomFinal.setInt(uBloom, bloom);
+        shaderBloomFinal.setFloat(uBloomIntensity, bloomIntensity);
+        shaderBloomFinal.setFloat(uExposure, exposure);
         renderQuad();
+        glActiveTexture(GL_TEXTURE0);
+        profiler.End();
+
+        // back to the pool for the next frame, which gets the same ones unless the sizes changed
+        renderTargets.Release(hdrTarget);
+        renderTargets.Release(brightTarget);
+        if (pingpong[1])
+            renderTargets.Release(*pingpong[1]);
+        renderTargets.EndFrame();
+
+        // the UI goes on top of the tonemapped image, so it doesn't bloom
+        if (programState->ImGuiEnabled) {
+            ProfileScope scope(profiler, "imgui");
+            DrawImGui(programState);
+        }
+        profiler.EndFrame();
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        if (bench.enabled) {
+            double frameEnd = glfwGetTime();
+            if (benchFrame >= bench.warmup) {
+                benchRecorder.cpuMs.push_back(profiler.CpuFrameMs());
+                benchRecorder.renderScale.push_back(renderScale);
+                if (benchFrame > 0)
+                    benchRecorder.frameMs.push_back((frameEnd - benchLastFrameEnd) * 1000.0);
+                // GPU times arrive a few frames late; take each one once
+                if (profiler.gpuFramesResolved != benchGpuFrames)
+                    benchRecorder.gpuMs.push_back(profiler.GpuFrameMs());
+            }
+            benchGpuFrames = profiler.gpuFramesResolved;
+            benchLastFrameEnd = frameEnd;
+            if (++benchFrame == bench.warmup + bench.frames)
+                glfwSetWindowShouldClose(window, true);
+        }
     }
 
 
-    programState->SaveToFile("resources/program_state.txt");
+    if (bench.enabled)
+        benchRecorder.WriteJson(bench.output, bench, (const char *) glGetString(GL_RENDERER));
+    else
+        programState->SaveToFile("resources/program_state.txt");
     delete programState;
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -687,42 +874,22 @@ int main() {
     // ------------------------------------------------------------------------
     glDeleteVertexArrays(1, &transparentVAO);
     glDeleteBuffers(1, &transparentVBO);
-    
+    TextureCache::Instance().Release(transparentTexture);
+    TextureCache::Instance().Release(cubemapTexture);
+    scene.Clear();
+    profiler.Clear();
+    bloomChain.Clear();
+    renderTargets.Clear();
+    deferred.Clear();
+    clusteredLights.Clear();
+    shadows.Clear();
+    pointShadows.Clear();
+    hiz.Clear();
+
     glfwTerminate();
     return 0;
 }
 
-// renderQuad() renders a 1x1 XY quad in NDC
-// __________________________________________________________________________________________
-unsigned int quadVAO = 0;
-unsigned int quadVBO;
-void renderQuad()
-{
-    if (quadVAO == 0)
-    {
-        float quadVertices[] = {
-                // positions        // texture Coords
-                -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-                -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-                1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-                1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        };
-        // setup plane VAO
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
-}
-
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window) {
@@ -749,6 +916,9 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    // the render targets follow on the next frame
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -795,6 +965,57 @@ void DrawImGui(ProgramState *programState) {
         ImGui::DragFloat("pointLight.constant", &programState->pointLight.constant, 0.05, 0.0, 1.0);
         ImGui::DragFloat("pointLight.linear", &programState->pointLight.linear, 0.05, 0.0, 1.0);
         ImGui::DragFloat("pointLight.quadratic", &programState->pointLight.quadratic, 0.05, 0.0, 1.0);
+
+        const char *bloomModes[] = {"Mip chain", "Gaussian"};
+        ImGui::Combo("Bloom", &bloomMode, bloomModes, IM_ARRAYSIZE(bloomModes));
+        ImGui::DragFloat("Bloom threshold", &bloomThreshold, 0.01f, 0.0f, 10.0f);
+        ImGui::DragFloat("Bloom knee", &bloomKnee, 0.01f, 0.0f, 2.0f);
+        if (bloomMode == BLOOM_MIP_CHAIN)
+            ImGui::SliderFloat("Bloom radius", &bloomFilterRadius, 0.001f, 0.02f);
+        else
+            ImGui::SliderFloat("Blur sigma", &blurSigma, 0.5f, 10.0f);
+        if (bloomMode == BLOOM_GAUSSIAN && computeBlurAvailable)
+            ImGui::Checkbox("Compute shader blur", &useComputeBlur);
+        const char *shadingPaths[] = {"Forward", "Deferred"};
+        ImGui::Combo("Shading", &shadingPath, shadingPaths, IM_ARRAYSIZE(shadingPaths));
+        ImGui::SliderInt("Lanterns", &lanternsShown, 0, LANTERN_COUNT);
+        ImGui::Checkbox("Depth pre-pass", &depthPrepass);
+        ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+        if (occlusionCulling)
+            ImGui::Text("Occlusion: %u of %u meshes hidden", occlusionCulled, occlusionTested);
+        ImGui::SliderFloat("LOD pixel error", &lodPixelError, 0.0f, 8.0f);
+        ImGui::Text("Scene triangles: %u", sceneTriangles);
+        ImGui::Checkbox("Shadows", &shadowsEnabled);
+        if (shadowsEnabled) {
+            const char *shadowResolutions[] = {"512", "1024", "2048", "4096"};
+            int resolutionIndex = 0;
+            while (resolutionIndex < 3 && (512 << resolutionIndex) < shadowResolution)
+                resolutionIndex++;
+            if (ImGui::Combo("Shadow resolution", &resolutionIndex, shadowResolutions, IM_ARRAYSIZE(shadowResolutions)))
+                shadowResolution = 512 << resolutionIndex;
+            ImGui::SliderInt("Cascades", &shadowCascades, 1, CascadedShadowMaps::MAX_CASCADES);
+            ImGui::SliderFloat("Shadow distance", &shadowDistance, 10.0f, CAMERA_FAR);
+            ImGui::SliderFloat("Cascade split lambda", &shadowSplitLambda, 0.0f, 1.0f);
+            ImGui::Checkbox("Cache static shadows", &shadowCache);
+            ImGui::Text("Shadow casters drawn: %u, static bakes: %u", shadowCasterDraws, shadowStaticBakes);
+        }
+        ImGui::Checkbox("Point light shadows", &pointShadowsEnabled);
+        if (pointShadowsEnabled) {
+            ImGui::SliderInt("Shadow updates per frame", &pointShadowBudget, 1, 16);
+            ImGui::Text("Shadowed lights: %u, updated: %u", pointShadowsShown, pointShadowsRefreshed);
+        }
+        if (shadingPath == SHADING_FORWARD)
+            ImGui::Text("Cluster lights: %u listed, at most %u per cluster", clusterLightIndices, clusterMaxLights);
+        ImGui::Checkbox("Dynamic resolution", &dynamicResolution.enabled);
+        if (dynamicResolution.enabled) {
+            ImGui::SliderFloat("GPU budget (ms)", &dynamicResolution.budgetMs, 4.0f, 50.0f);
+            ImGui::DragFloatRange2("Scale range", &dynamicResolution.minScale, &dynamicResolution.maxScale, 0.01f,
+                                   RENDER_SCALE_MIN, RENDER_SCALE_MAX);
+            ImGui::Text("Render scale: %.2f", renderScale);
+        } else
+            ImGui::SliderFloat("Render scale", &renderScale, RENDER_SCALE_MIN, RENDER_SCALE_MAX);
+        ImGui::Text("Scene resolution: %dx%d", std::max(1, (int) (framebufferWidth * renderScale)),
+                    std::max(1, (int) (framebufferHeight * renderScale)));
         ImGui::End();
     }
 
@@ -808,6 +1029,32 @@ void DrawImGui(ProgramState *programState) {
         ImGui::End();
     }
 
+    {
+        ImGui::Begin("Profiler");
+        ImGui::Text("Frame: CPU %.2f ms, GPU %.2f ms", profiler.CpuFrameMs(), profiler.GpuFrameMs());
+        if (ImGui::BeginTable("passes", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Pass");
+            ImGui::TableSetupColumn("CPU ms");
+            ImGui::TableSetupColumn("GPU ms");
+            ImGui::TableHeadersRow();
+            for (const Profiler::Pass &pass : profiler.passes) {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::TextUnformatted(pass.name.c_str());
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%.3f", pass.cpuMs);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%.3f", pass.gpuMs);
+            }
+            ImGui::EndTable();
+        }
+        ImGui::PlotLines("CPU frame", profiler.cpuFrameHistory, Profiler::HISTORY, profiler.historyOffset,
+                         NULL, 0.0f, 33.3f, ImVec2(0, 60));
+        ImGui::PlotLines("GPU frame", profiler.gpuFrameHistory, Profiler::HISTORY, profiler.historyOffset,
+                         NULL, 0.0f, 33.3f, ImVec2(0, 60));
+        ImGui::End();
+    }
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
@@ -853,72 +1100,38 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 }
 
 
+// both loaders go through the TextureCache, which only queues the decode the first time a file is requested
 unsigned int loadCubemap(vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
+    return TextureCache::Instance().AcquireCubemap(faces);
 }
 
 
 unsigned int loadTexture(char const * path)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return TextureCache::Instance().Acquire(path, TEXTURE_CLAMP_ALPHA);
 }
 
 
+// lanterns scattered around the farmhouse on a sunflower spiral, so they cover the yard evenly without a visible grid
+void placeLanterns(std::vector<PointLightSource> &lights, unsigned int count)
+{
+    const glm::vec3 center(-66.0f, 2.8f, 48.0f);
+    const float goldenAngle = 2.39996323f;
+    lights.clear();
+    for (unsigned int i = 0; i < count; i++) {
+        float distance = 5.0f + 18.0f * std::sqrt((i + 0.5f) / count);
+        float angle = i * goldenAngle;
+        PointLightSource light;
+        light.position = center + glm::vec3(distance * std::cos(angle), 0.4f * std::sin(i * 1.7f), distance * std::sin(angle));
+        light.radius = 3.5f;
+        // warm flames, each a little different, falling off with the inverse square of the distance
+        float flicker = 0.5f + 0.5f * std::sin(i * 12.9898f);
+        light.ambient = glm::vec3(0.0f);
+        light.diffuse = light.specular = glm::vec3(1.0f, 0.55f + 0.15f * flicker, 0.2f + 0.1f * flicker) * (4.0f + 2.0f * flicker);
+        light.constant = 1.0f;
+        light.linear = 0.0f;
+        light.quadratic = 1.0f;
+        lights.push_back(light);
+    }
+}